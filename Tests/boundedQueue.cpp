@@ -0,0 +1,123 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <vector>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//spsc, mpsc and mpmc queues: full and empty at the edges, order, many laps, and under threads every item arrives exactly once and each producer's items arrive in the order they were pushed
+
+constexpr uint64_t capacity = 64, perProducer = 200000;
+
+template<class Q> void edges() {
+  Q q;
+  uint64_t v;
+  if(q.pop(v) || !q.empty()) [[unlikely]]
+    WITE_ERROR("new queue is not empty");
+  for(uint64_t lap = 0;lap < 10;lap++) {
+    for(uint64_t i = 0;i < capacity;i++)
+      if(!q.push(lap * capacity + i)) [[unlikely]]
+	WITE_ERROR("push failed before the queue was full");
+    if(q.push(uint64_t(0)) || q.size() != capacity) [[unlikely]]
+      WITE_ERROR("push succeeded on a full queue");
+    for(uint64_t i = 0;i < capacity;i++)
+      if(!q.pop(v) || v != lap * capacity + i) [[unlikely]]
+	WITE_ERROR("wrong item or order");
+    if(q.pop(v)) [[unlikely]]
+      WITE_ERROR("pop succeeded on an empty queue");
+  }
+  //partial laps, so head and tail wrap at different points
+  uint64_t next = 0, expect = 0;
+  for(uint64_t round = 0;round < 1000;round++) {
+    for(uint64_t i = 0;i < round % 7 + 1;i++)
+      if(q.push(next)) next++;
+    for(uint64_t i = 0;i < round % 5 + 1;i++)
+      if(q.pop(v) && v != expect++) [[unlikely]]
+	WITE_ERROR("wrong item after wrapping");
+  }
+};
+
+//items are moved out, not copied and left behind
+template<class Q> void ownership() {
+  Q q;
+  std::shared_ptr<int> p = std::make_shared<int>(5), out;
+  q.push(p);
+  if(p.use_count() != 2) [[unlikely]] WITE_ERROR("push did not copy");
+  q.pop(out);
+  if(p.use_count() != 2 || *out != 5) [[unlikely]] WITE_ERROR("pop did not move");
+};
+
+template<class Q> void peeking() {
+  Q q;
+  if(q.peek()) [[unlikely]] WITE_ERROR("peeked an empty queue");
+  q.push(uint64_t(1));
+  q.push(uint64_t(2));
+  uint64_t v;
+  if(!q.peek() || *q.peek() != 1 || !q.pop(v) || v != 1 || *q.peek() != 2) [[unlikely]]
+    WITE_ERROR("peek does not show the next item");
+};
+
+template<class Q> void threaded(size_t producers, size_t consumers) {
+  Q q;
+  std::atomic_uint64_t done = 0;
+  std::vector<std::atomic_uint8_t> seen(producers * perProducer);
+  std::atomic_uint64_t bad = 0;
+  std::vector<thread*> threads;
+  for(size_t p = 0;p < producers;p++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&q, p]() {
+      uint32_t sleepCnt = 0;
+      for(uint64_t i = 0;i < perProducer;i++)
+	while(!q.push(p << 32 | i))
+	  thread::sleepShort(sleepCnt);
+    })));
+  for(size_t c = 0;c < consumers;c++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&, producers]() {
+      std::vector<int64_t> last(producers, -1);
+      uint32_t sleepCnt = 0;
+      uint64_t v;
+      while(done.load(std::memory_order_relaxed) < producers * perProducer) {
+	if(!q.pop(v)) {
+	  thread::sleepShort(sleepCnt);
+	  continue;
+	}
+	const uint64_t p = v >> 32, i = v & 0xFFFFFFFF;
+	if(p >= producers || int64_t(i) <= last[p] || seen[p * perProducer + i].fetch_add(1)) [[unlikely]]
+	  bad++;
+	last[p] = i;
+	done.fetch_add(1, std::memory_order_relaxed);
+      }
+    })));
+  for(thread* t : threads)
+    t->join();
+  if(bad.load() || !q.empty()) [[unlikely]]
+    WITE_ERROR("items lost, duplicated or reordered with ", producers, " producers and ", consumers, " consumers");
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  edges<spscQueue<uint64_t, capacity>>();
+  edges<mpscQueue<uint64_t, capacity>>();
+  edges<mpmcQueue<uint64_t, capacity>>();
+  ownership<spscQueue<std::shared_ptr<int>, capacity>>();
+  ownership<mpscQueue<std::shared_ptr<int>, capacity>>();
+  ownership<mpmcQueue<std::shared_ptr<int>, capacity>>();
+  peeking<spscQueue<uint64_t, capacity>>();
+  peeking<mpscQueue<uint64_t, capacity>>();
+  threaded<spscQueue<uint64_t, capacity>>(1, 1);
+  threaded<mpscQueue<uint64_t, capacity>>(4, 1);
+  threaded<mpmcQueue<uint64_t, capacity>>(4, 4);
+  threaded<mpmcQueue<uint64_t, capacity>>(1, 4);
+};
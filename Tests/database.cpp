@@ -20,12 +20,15 @@ struct spawner {
   uint64_t spawnedCount = 0;
   uint8_t spawnDirection = 0;
   float locationX = 0, locationY = 0, deltaX = 0, deltaY = 0;
+  static std::atomic_uint64_t lastUpdatedFrame, lastUpdateTicket;
   static void update(uint64_t oid, void* db_unused);
+  static void updated(uint64_t frame);
 };
 
 struct unit {
   static constexpr uint64_t typeId = __LINE__;
   static constexpr std::string dbFileId = "unit";
+  static constexpr size_t dbShardCount = 4;//exercises sharded tables
   static std::atomic_uint64_t updates, allocates, frees, spunUps, spunDowns;
   float locationX = 0, locationY = 0, deltaX = 0, deltaY = 0;
   int ttl;
@@ -34,27 +37,46 @@ struct unit {
   static void freed(uint64_t oid, void* db_unused);
   static void spunUp(uint64_t oid, void* db_unused);
   static void spunDown(uint64_t oid, void* db_unused);
-  typedef std::tuple<float, float> indices_t;
+  typedef std::tuple<spawner> updateAfter;
+  typedef WITE::dbCovering<std::tuple<float, float>, float> byDeltaXAndX_t;//composite key with the Y location covered
+  typedef std::tuple<float, float, byDeltaXAndX_t> indices_t;
   static indices_t getIndexValues(uint64_t oid, const unit& data, void* db_unused);
 };
 
 struct timer {
   static constexpr uint64_t typeId = __LINE__;
   static constexpr std::string dbFileId = "timer";
+  static std::atomic_uint64_t updates;
   static void update(uint64_t oid, void* db_unused);
+  typedef std::tuple<spawner> updateAfter;//so the spawner's poke always lands before the timer's sleep in the same frame
 };
 
+static_assert(WITE::dbUpdatePhaseOf<spawner>::value == 0 && WITE::dbUpdatePhaseOf<unit>::value == 1);
+
 float boxWidth = 1080, boxHeight = 1920;
 
 typedef WITE::database<spawner, unit, timer> db_t;
 std::unique_ptr<db_t> db;
 std::atomic_bool running;
+uint64_t timerId;
 
 //having the function definitions out of line might seem odd in this context, but in reality they should be each in their own compilation unit (cpp file).
 
+//phase order check: every spawner and unit update takes a ticket from one counter. A spawner records its frame and ticket as it finishes, and a unit of the same frame must hold a later ticket.
+std::atomic_uint64_t updateTicket, spawner::lastUpdatedFrame, spawner::lastUpdateTicket;
+
+void spawner::updated(uint64_t frame) {
+  lastUpdateTicket = updateTicket++;
+  lastUpdatedFrame = frame;
+};
+
 void spawner::update(uint64_t oid, void* db_unused) {
   spawner s;
-  if(!db->readCommitted<spawner>(oid, &s)) return;
+  const uint64_t frame = db->getFrame();
+  if(!db->readCommitted<spawner>(oid, &s)) {
+    updated(frame);
+    return;
+  }
   s.locationX += s.deltaX;
   s.locationY += s.deltaY;
   if(s.locationX < 0) {
@@ -83,6 +105,13 @@ void spawner::update(uint64_t oid, void* db_unused) {
   s.spawnDirection = (s.spawnDirection + 1) % 9;
   db->create(&u);
   db->write<spawner>(oid, &s);
+  if(frame == 250) {
+    //poke the sleeping timer, which should wake it
+    timer t;
+    if(db->readCommitted<timer>(timerId, &t))
+      db->write<timer>(timerId, &t);
+  }
+  updated(frame);
 };
 
 std::atomic_uint64_t unit::updates, unit::allocates, unit::frees, unit::spunUps, unit::spunDowns;
@@ -90,6 +119,9 @@ std::atomic_uint64_t unit::updates, unit::allocates, unit::frees, unit::spunUps,
 void unit::update(uint64_t oid, void* db_unused) {
   unit s;
   updates++;
+  const uint64_t frame = db->getFrame(), ticket = updateTicket++;
+  if(spawner::lastUpdatedFrame != frame || ticket < spawner::lastUpdateTicket) [[unlikely]]
+    WITE_ERROR("unit updated before spawner");
   if(!db->readCommitted<unit>(oid, &s)) return;
   { //test lookup that might have multiple hits, must include this one
     ASSERT_TRAP((db->template findByIdx<unit, 0>(s.locationX) != WITE::NONE), "exact match not found but should at least find this one");
@@ -99,6 +131,18 @@ void unit::update(uint64_t oid, void* db_unused) {
 	found = true;
     });
     ASSERT_TRAP(found, "could not find this object in the index of objects by locationY with this object's Y");
+    found = false;
+    db->foreachByIdx<unit, 2>(std::tuple(s.deltaX, s.locationX), [&found, oid, &s](const byDeltaXAndX_t& v, uint64_t ooid) {
+      if(ooid == oid) [[unlikely]] {
+	ASSERT_TRAP(v.payload == s.locationY, "covered value does not match the object");
+	found = true;
+      }
+    });
+    ASSERT_TRAP(found, "could not find this object in the composite index with this object's delta X and X");
+    //prefix query: every unit with this delta X, regardless of X
+    ASSERT_TRAP((db->template countByIdx<unit, 2>(std::tuple(s.deltaX, std::numeric_limits<float>::lowest()),
+						 std::tuple(s.deltaX, std::numeric_limits<float>::max())) > 0),
+		"prefix range on composite index should at least find this one");
   }
   if(s.ttl-- < 0) {
     db->destroy<unit>(oid);
@@ -142,15 +186,20 @@ void unit::spunDown(uint64_t oid, void* db_unused) {
 };
 
 unit::indices_t unit::getIndexValues(uint64_t oid, const unit& data, void*) {
-  return std::tie(data.locationX, data.locationY);
+  return { data.locationX, data.locationY, { { data.deltaX, data.locationX }, data.locationY } };
 };
 
+std::atomic_uint64_t timer::updates;
+
 void timer::update(uint64_t oid, void* db_unused) {
   timer s;
+  updates++;
   if(!db->readCommitted<timer>(oid, &s)) return;
   if(db->getFrame() > 500)
     running = false;
-  db->write<timer>(oid, &s);
+  db->write<timer>(oid, &s);//writing to itself does not wake it
+  db->sleep<timer>(oid, 501);//so the timer only runs on the first frame, when poked by the spawner, and on frame 501
+  //the poke at frame 250 wakes it for that frame, and its sleep in that frame doesn't cancel the poke (it only read the committed frame, so it hasn't seen the poke), so it also runs at 251
 };
 
 int main(int argc, const char** argv) {
@@ -163,15 +212,24 @@ int main(int argc, const char** argv) {
   s.deltaX = s.deltaY = 1;
   db->create<spawner>(&s);
   timer t;
-  db->create<timer>(&t);
+  timerId = db->create<timer>(&t);
   //game loop
   running = true;
+  uint64_t unitUpdatesSeen = 0, unitAllocationsSeen = 0, timerUpdatesSeen = 0;
   while(running) {
     db->updateTick();
     db->endFrame();
+    auto stats = db->getFrameStats();
+    ASSERT_TRAP(stats.frame == db->getFrame() - 1, "frame stats should be of the frame that just ended");
+    unitUpdatesSeen += stats.tables[1].updates;
+    unitAllocationsSeen += stats.tables[1].allocations;
+    timerUpdatesSeen += stats.tables[2].updates;
   }
   db->gracefulShutdown();
   db->deleteFiles();
+  ASSERT_TRAP(unitUpdatesSeen == unit::updates && unitAllocationsSeen == unit::allocates && timerUpdatesSeen == timer::updates, "frame stats do not add up");
+  ASSERT_TRAP(db->getTableCounters<unit>().frees == unit::frees, "table counters do not match");
+  ASSERT_TRAP(timer::updates == 4, "timer should have slept between updates, updated: ", timer::updates);
   std::cout << "updates: " << unit::updates << " allocates: " << unit::allocates << " frees: " << unit::frees << " spunUps: " << unit::spunUps << " spunDowns: " << unit::spunDowns << "\n";
   db.reset();
 };
@@ -0,0 +1,110 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../WITE/WITE.hpp"
+
+//update throughput over a table too big for cache, under each thread placement policy. Each policy runs in its own process, because the pool reads its placement when it is created.
+//run with threadcpus=... or threadnodes=... to try other topologies.
+
+struct cell {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "cell";
+  static constexpr size_t dbShardCount = 4;
+  float values[62];
+  uint64_t generation = 0;
+  static void update(uint64_t oid, void* db_unused);
+};
+
+typedef WITE::database<cell> db_t;
+std::unique_ptr<db_t> db;
+
+void cell::update(uint64_t oid, void*) {
+  cell c;
+  if(!db->readCommitted<cell>(oid, &c)) [[unlikely]] return;
+  for(float& v : c.values)
+    v = v * 0.5f + 1;
+  c.generation++;
+  db->write<cell>(oid, &c);
+};
+
+uint64_t getNs() {
+  return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()).time_since_epoch().count();
+};
+
+constexpr uint64_t objectCount = 200000, warmupFrames = 3, frames = 20;
+
+//returns updates per second
+double run(const char* policy) {
+  std::filesystem::path dirPath = std::filesystem::temp_directory_path() / (std::string("wite_db_affinity_benchmark_") + policy);
+  db = std::make_unique<db_t>(dirPath.string(), true, true);
+  cell c {};
+  for(uint64_t i = 0;i < objectCount;i++)
+    db->create<cell>(&c);
+  for(uint64_t i = 0;i < warmupFrames;i++) {
+    db->updateTick();
+    db->endFrame();
+  }
+  const uint64_t start = getNs();
+  for(uint64_t i = 0;i < frames;i++) {
+    db->updateTick();
+    db->endFrame();
+  }
+  const uint64_t time = getNs() - start;
+  db->gracefulShutdown();
+  db->deleteFiles();
+  db.reset();
+  return double(objectCount * frames) * 1000000000 / time;
+};
+
+int main(int argc, const char** argv) {
+  WITE::configuration::setOptions(argc, argv);
+  const auto& nodes = WITE::thread::numaNodes();
+  std::cout << nodes.size() << " NUMA node(s):";
+  for(const auto& node : nodes)
+    std::cout << " [" << node.size() << " cpus from " << node.front() << "]";
+  std::cout << "\n";
+  for(const char* policy : { "none", "cores", "nodes" }) {
+    //fork before any threads exist
+    int reportPipe[2];
+    if(pipe(reportPipe) != 0) [[unlikely]]
+      WITE_ERROR("pipe failed");
+    pid_t child = fork();
+    if(child < 0) [[unlikely]]
+      WITE_ERROR("fork failed");
+    if(child == 0) {
+      close(reportPipe[0]);
+      std::vector<const char*> args(argv, argv + argc);
+      const std::string option = std::string("threadaffinity=") + policy;
+      args.push_back(option.c_str());
+      WITE::configuration::setOptions(static_cast<int>(args.size()), args.data());
+      const double rate = run(policy);
+      if(write(reportPipe[1], &rate, sizeof(rate)) != sizeof(rate)) [[unlikely]]
+	WITE_ERROR("report failed");
+      close(reportPipe[1]);
+      std::exit(0);
+    }
+    close(reportPipe[1]);
+    double rate = 0;
+    const bool reported = read(reportPipe[0], &rate, sizeof(rate)) == sizeof(rate);
+    close(reportPipe[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if(!reported || !WIFEXITED(status) || WEXITSTATUS(status) != 0) [[unlikely]]
+      WITE_ERROR("benchmark process for ", policy, " failed");
+    std::cout << "threadaffinity=" << policy << " \tupdates per second: " << static_cast<uint64_t>(rate) << "\n";
+  }
+};
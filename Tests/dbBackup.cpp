@@ -0,0 +1,138 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include "../WITE/WITE.hpp"
+
+//objects that count their own updates and destroy themselves after a while, so every backup has creates, writes and destroys in it
+struct counter {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "counter";
+  static constexpr size_t dbShardCount = 3;//exercises restoring sharded tables
+  uint64_t value = 0, ttl = 0;
+  static void update(uint64_t oid, void* db_unused);
+  static std::tuple<uint64_t> getIndexValues(uint64_t oid, const counter& data, void*) {
+    return { data.ttl };
+  };
+};
+
+typedef WITE::database<counter> db_t;
+typedef WITE::dbReplica<counter> replica_t;
+std::unique_ptr<db_t> db;
+std::set<uint64_t> allIds;
+
+void counter::update(uint64_t oid, void* db_unused) {
+  counter s;
+  if(!db->readCommitted<counter>(oid, &s)) return;
+  s.value++;
+  if(--s.ttl == 0)
+    db->destroy<counter>(oid);
+  else
+    db->write<counter>(oid, &s);
+};
+
+//value of every object that has ever existed, as of the last complete frame
+template<class L> std::map<uint64_t, uint64_t> snapshot(L read) {
+  std::map<uint64_t, uint64_t> ret;
+  counter s;
+  for(uint64_t oid : allIds)
+    if(read(oid, &s))
+      ret[oid] = s.value;
+  return ret;
+};
+
+std::map<uint64_t, uint64_t> snapshot(db_t& d) {
+  return snapshot([&d](uint64_t oid, counter* s) { return d.readCommitted<counter>(oid, s); });
+};
+
+std::map<uint64_t, uint64_t> snapshot(replica_t& r) {
+  return snapshot([&r](uint64_t oid, counter* s) { return r.read<counter>(oid, s); });
+};
+
+void checkReplica(replica_t& r, uint64_t expectedFrame, const std::map<uint64_t, uint64_t>& expected) {
+  ASSERT_TRAP(r.getFrame() == expectedFrame, "replica has the wrong frame: ", r.getFrame(), " expected: ", expectedFrame);
+  ASSERT_TRAP(snapshot(r) == expected, "replica data does not match the state at frame ", expectedFrame);
+  uint64_t count = 0;
+  r.forEach<counter>([&count](uint64_t, const counter&) { count++; });
+  ASSERT_TRAP(count == expected.size() && (r.countByIdx<counter, 0>(0, ~0ull)) == expected.size(), "replica iteration or index does not match");
+};
+
+void checkRestore(const std::filesystem::path& backupPath, const std::filesystem::path& restorePath, uint64_t throughFrame, uint64_t expectedFrame, const std::map<uint64_t, uint64_t>& expected) {
+  ASSERT_TRAP(db_t::restoreBackup(backupPath, restorePath, throughFrame) == expectedFrame, "restored to wrong frame, expected: ", expectedFrame);
+  {
+    replica_t r(restorePath, replica_t::source_e::eMaster);
+    checkReplica(r, expectedFrame, expected);
+  }
+  db_t restored(restorePath, false, true);
+  ASSERT_TRAP(restored.getFrame() == expectedFrame + 1, "restored database should resume after the backup's frame");
+  ASSERT_TRAP(snapshot(restored) == expected, "restored data does not match the state at frame ", expectedFrame);
+  restored.deleteFiles();
+};
+
+int main(int argc, const char** argv) {
+  WITE::configuration::setOptions(argc, argv);
+  std::filesystem::path dirPath = std::filesystem::temp_directory_path() / "wite_db_backup_test",
+    backupPath = dirPath / "backup", restorePath = dirPath / "restore";
+  std::filesystem::remove_all(dirPath);
+  db = std::make_unique<db_t>(dirPath / "db", true, true);
+  //full backups at 50 and 170, increments at the rest
+  const std::map<uint64_t, bool> backups { { 50, true }, { 100, false }, { 150, false }, { 170, true }, { 190, false } };
+  std::map<uint64_t, std::map<uint64_t, uint64_t>> expected;
+  //a replica tailing the backups as they are written
+  std::unique_ptr<replica_t> tail;
+  uint64_t lastBackupFrame = WITE::NONE;
+  while(db->getFrame() <= 200) {
+    const uint64_t frame = db->getFrame();
+    if(lastBackupFrame != WITE::NONE && !db->isBackupInProgress()) {
+      if(tail) {
+	ASSERT_TRAP(tail->refreshIfDue(), "replica did not see the new backup");
+      } else {
+	tail = std::make_unique<replica_t>(backupPath, replica_t::source_e::eBackup, 0);
+      }
+      checkReplica(*tail, lastBackupFrame, expected[lastBackupFrame]);
+      ASSERT_TRAP(!tail->refreshIfDue(), "replica refreshed without a new backup");
+      lastBackupFrame = WITE::NONE;
+    }
+    auto backup = backups.find(frame);
+    if(backup != backups.end()) {
+      ASSERT_TRAP(db->requestBackup(backupPath.string(), backup->second), "previous backup did not finish in time");
+      lastBackupFrame = frame;
+    }
+    for(uint64_t i = 0;i < 5;i++) {
+      counter c;
+      c.ttl = (frame * 7 + i) % 40 + 1;
+      allIds.insert(db->create<counter>(&c));
+    }
+    db->updateTick();
+    db->endFrame();
+    if(backup != backups.end())
+      expected[frame] = snapshot(*db);
+  }
+  //one more increment, which is written by the shutdown
+  const uint64_t lastFrame = db->getFrame() - 1;
+  expected[lastFrame] = snapshot(*db);
+  ASSERT_TRAP(db->requestBackup(backupPath.string(), false), "previous backup did not finish in time");
+  tail.reset();
+  db->gracefulShutdown();
+  ASSERT_TRAP(!db->isBackupInProgress(), "backup not written by shutdown");
+  db->deleteFiles();
+  db.reset();
+  checkRestore(backupPath, restorePath, WITE::NONE, lastFrame, expected[lastFrame]);
+  checkRestore(backupPath, restorePath, 100, 100, expected[100]);//full and one increment
+  checkRestore(backupPath, restorePath, 169, 150, expected[150]);//full and two increments
+  checkRestore(backupPath, restorePath, 195, 190, expected[190]);//newer full and one increment
+  checkRestore(backupPath, restorePath, 170, 170, expected[170]);//full only
+  ASSERT_TRAP(db_t::restoreBackup(backupPath, restorePath, 49) == WITE::NONE, "there should be nothing to restore before the first full backup");
+  std::filesystem::remove_all(dirPath);
+  std::cout << "restored " << expected.size() << " backups\n";
+};
@@ -0,0 +1,133 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include "../WITE/WITE.hpp"
+
+//objects that replace their variable-length contents every update, so every frame frees and writes blobs of many sizes
+struct bag {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "bag";
+  WITE::dbBlobHandle items = WITE::NONE;
+  uint64_t version = 0, seed = 0;
+  static void update(uint64_t oid, void* db_unused);
+};
+
+typedef WITE::database<bag> db_t;
+std::unique_ptr<db_t> db;
+std::vector<uint64_t> allIds;
+
+//most versions are small, every 16th is big enough to need one of the largest classes
+uint64_t itemCount(const bag& b) {
+  return b.version % 16 == 15 ? 100000 : (b.version * 37 + b.seed) % 700;
+};
+
+uint32_t itemFor(const bag& b, uint64_t i) {
+  return static_cast<uint32_t>(b.version * 0x9E3779B1 ^ b.seed ^ i);
+};
+
+void check(const bag& b, std::span<const uint32_t> items) {
+  ASSERT_TRAP(items.size() == itemCount(b), "wrong blob size for version ", b.version, ": ", items.size());
+  for(uint64_t i = 0;i < items.size();i++)
+    ASSERT_TRAP(items[i] == itemFor(b, i), "wrong blob contents for version ", b.version, " at ", i);
+};
+
+void check(const bag& b) {
+  check(b, db->readBlobAs<uint32_t>(b.items));
+};
+
+//every bag is at the same version, returns it
+uint64_t checkAll() {
+  uint64_t version = WITE::NONE;
+  for(uint64_t oid : allIds) {
+    bag b;
+    if(!db->readCommitted<bag>(oid, &b)) [[unlikely]]
+      WITE_ERROR("bag missing");
+    check(b);
+    ASSERT_TRAP(version == WITE::NONE || version == b.version, "bags out of step");
+    version = b.version;
+  }
+  return version;
+};
+
+void fill(bag& b) {
+  std::vector<uint32_t> items(itemCount(b));
+  for(uint64_t i = 0;i < items.size();i++)
+    items[i] = itemFor(b, i);
+  b.items = db->writeBlob(std::span<const uint32_t>(items));
+};
+
+void bag::update(uint64_t oid, void* db_unused) {
+  bag b;
+  if(!db->readCommitted<bag>(oid, &b)) return;
+  check(b);
+  //older frames still point at older blobs, which must not have been reclaimed yet
+  bag old;
+  if(db->read<bag>(oid, MIN_LOG_HISTORY, &old))
+    check(old);
+  db->freeBlob(b.items);
+  b.version++;
+  fill(b);
+  db->write<bag>(oid, &b);
+};
+
+int main(int argc, const char** argv) {
+  WITE::configuration::setOptions(argc, argv);
+  std::filesystem::path dirPath = std::filesystem::temp_directory_path() / "wite_db_blob_test",
+    dbPath = dirPath / "db", backupPath = dirPath / "backup", restorePath = dirPath / "restore";
+  std::filesystem::remove_all(dirPath);
+  db = std::make_unique<db_t>(dbPath, true, true);
+  for(uint64_t i = 0;i < 50;i++) {
+    bag b;
+    b.seed = i;
+    fill(b);
+    allIds.push_back(db->create<bag>(&b));
+  }
+  uint64_t backupVersion = WITE::NONE;
+  while(db->getFrame() < 200) {
+    const bool backup = db->getFrame() == 100;
+    if(backup)
+      ASSERT_TRAP(db->requestBackup(backupPath.string()), "backup refused");
+    db->updateTick();
+    db->endFrame();
+    if(backup)
+      backupVersion = checkAll();
+  }
+  db->gracefulShutdown();
+  //every replaced blob has been reclaimed
+  ASSERT_TRAP(db->blobCount() == allIds.size(), "blobs leaked: ", db->blobCount());
+  db.reset();
+  db = std::make_unique<db_t>(dbPath, false, true);
+  const uint64_t version = checkAll();
+  ASSERT_TRAP(db->blobCount() == allIds.size(), "blobs leaked across reload: ", db->blobCount());
+  db->deleteFiles();
+  db.reset();
+  //the backup was copied after later frames had allocated and freed blobs, which the restored database must reclaim and keep respectively
+  ASSERT_TRAP(db_t::restoreBackup(backupPath, restorePath) == 100, "restored to wrong frame");
+  {
+    WITE::dbReplica<bag> r(restorePath, WITE::dbReplica<bag>::source_e::eMaster);
+    r.forEach<bag>([&r, backupVersion](uint64_t, const bag& b) {
+      if(b.version != backupVersion) [[unlikely]]
+	WITE_ERROR("replica bag at wrong version");
+      check(b, r.readBlobAs<uint32_t>(b.items));
+    });
+  }
+  db = std::make_unique<db_t>(restorePath, false, true);
+  ASSERT_TRAP(checkAll() == backupVersion, "restored bags at wrong version");
+  db->gracefulShutdown();
+  ASSERT_TRAP(db->blobCount() == allIds.size(), "blobs leaked across restore: ", db->blobCount());
+  db->deleteFiles();
+  db.reset();
+  std::filesystem::remove_all(dirPath);
+  std::cout << "bags at version " << version << "\n";
+};
@@ -0,0 +1,234 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../WITE/WITE.hpp"
+
+//objects that count up every update and destroy themselves after a while, so every frame has creates, updates and deletes
+struct mover {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "mover";
+  uint64_t value = 0, ttl = 0;
+  static void update(uint64_t oid, void* db_unused);
+};
+
+//never changes after it is created, so should only ever appear in the feed once
+struct marker {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "marker";
+  uint64_t value = 0;
+};
+
+typedef WITE::database<mover, marker> db_t;
+typedef WITE::dbChangeFeed feed_t;
+std::unique_ptr<db_t> db;
+
+void mover::update(uint64_t oid, void* db_unused) {
+  mover m;
+  if(!db->readCommitted<mover>(oid, &m)) return;
+  m.value++;
+  if(--m.ttl == 0)
+    db->destroy<mover>(oid);
+  else
+    db->write<mover>(oid, &m);
+};
+
+//what a consumer rebuilds from the feed: the value of every object, by type and id
+struct mirror {
+  std::map<std::pair<uint64_t, uint64_t>, uint64_t> objects;
+  uint64_t frame = WITE::NONE, records = 0, frames = 0, markerRecords = 0;
+
+  void apply(const feed_t::record_t& r, std::span<const uint8_t> payload) {
+    ASSERT_TRAP(r.op != feed_t::op_e::eGap, "unexpected gap in the feed");
+    ASSERT_TRAP(frame == WITE::NONE || r.frame == frame || (r.frame == frame + 1 && records == 0), "records out of frame order");
+    frame = r.frame;
+    const std::pair<uint64_t, uint64_t> key { r.typeId, r.id };
+    uint64_t value;
+    switch(r.op) {
+    case feed_t::op_e::eCreate:
+      ASSERT_TRAP(!objects.contains(key), "created twice");
+      [[fallthrough]];
+    case feed_t::op_e::eUpdate:
+      ASSERT_TRAP(r.op == feed_t::op_e::eCreate || objects.contains(key), "update before create");
+      ASSERT_TRAP(payload.size() == sizeof(uint64_t) * (r.typeId == mover::typeId ? 2 : 1), "wrong payload size");
+      std::memcpy(&value, payload.data(), sizeof(value));
+      objects[key] = value;
+      if(r.typeId == marker::typeId) markerRecords++;
+      records++;
+      break;
+    case feed_t::op_e::eDelete:
+      ASSERT_TRAP(objects.contains(key), "delete of unknown object");
+      objects.erase(key);
+      records++;
+      break;
+    case feed_t::op_e::eFrameEnd:
+      ASSERT_TRAP(r.id == records, "frame end count does not match: ", r.id, " ", records);
+      records = 0;
+      frames++;
+      break;
+    default:
+      WITE_ERROR("bad op");
+    }
+  };
+
+  uint64_t hash() {
+    uint64_t ret = frames;
+    for(auto& [key, value] : objects)
+      ret = ret * 31 + key.first * 7 + key.second * 13 + value;
+    return ret;
+  };
+};
+
+//the database's own view of the last committed frame, in the same form
+mirror snapshot(const std::set<uint64_t>& movers, uint64_t markerId) {
+  mirror ret;
+  ret.objects[{ marker::typeId, markerId }] = 42;
+  for(uint64_t oid : movers) {
+    mover d;
+    if(db->readCommitted<mover>(oid, &d))
+      ret.objects[{ mover::typeId, oid }] = d.value;
+  }
+  return ret;
+};
+
+//runs the database for a while, calling onFrame after each frame is committed. Returns the final state.
+template<class F> mirror run(feed_t* feed, F onFrame) {
+  std::set<uint64_t> movers;
+  marker mk { .value = 42 };
+  uint64_t markerId = db->create<marker>(&mk);
+  while(db->getFrame() < 300) {
+    const uint64_t frame = db->getFrame();
+    for(uint64_t i = 0;i < 3;i++) {
+      mover c;
+      c.ttl = (frame * 5 + i) % 30 + 1;
+      movers.insert(db->create<mover>(&c));
+    }
+    db->updateTick();
+    db->endFrame();
+    onFrame(movers, markerId);
+  }
+  ASSERT_TRAP(feed->getFramesDropped() == 0, "frames dropped with a consumer keeping up");
+  mirror ret = snapshot(movers, markerId);
+  ret.frames = feed->getFramesPublished();
+  return ret;
+};
+
+//a tiny ring drops frames that don't fit, and tells the consumer
+void testGap() {
+  feed_t feed(4096);
+  uint8_t payload[1000] {};
+  auto frame = [&](uint64_t f, uint64_t records) {
+    feed.beginFrame();
+    for(uint64_t i = 0;i < records;i++)
+      feed.append(1, i, f, feed_t::op_e::eUpdate, payload, sizeof(payload));
+    feed.endFrame(f);
+  };
+  frame(1, 2);
+  frame(2, 2);//doesn't fit behind frame 1
+  frame(3, 5);//never fits
+  ASSERT_TRAP(feed.getFramesPublished() == 1 && feed.getFramesDropped() == 2, "tiny feed should have dropped frames");
+  std::vector<feed_t::op_e> ops;
+  std::vector<uint64_t> frames;
+  auto collect = [&](const feed_t::record_t& r, std::span<const uint8_t>) { ops.push_back(r.op); frames.push_back(r.frame); };
+  feed.consume(collect);
+  frame(4, 3);//fits now, across the end of the ring
+  feed.consume(collect);
+  const std::vector<feed_t::op_e> expectedOps { feed_t::op_e::eUpdate, feed_t::op_e::eUpdate, feed_t::op_e::eFrameEnd,
+    feed_t::op_e::eGap, feed_t::op_e::eUpdate, feed_t::op_e::eUpdate, feed_t::op_e::eUpdate, feed_t::op_e::eFrameEnd };
+  const std::vector<uint64_t> expectedFrames { 1, 1, 1, 2, 4, 4, 4, 4 };
+  ASSERT_TRAP(ops == expectedOps && frames == expectedFrames, "wrong records around a gap");
+};
+
+//child process: mirrors the feed from a pipe and reports what it ended up with
+int consumer(int in, int out) {
+  mirror m;
+  std::vector<uint8_t> buf;
+  uint8_t chunk[65536];
+  ssize_t got;
+  while((got = read(in, chunk, sizeof(chunk))) > 0) {
+    buf.insert(buf.end(), chunk, chunk + got);
+    size_t pos = 0;
+    while(buf.size() - pos >= sizeof(feed_t::record_t)) {
+      feed_t::record_t r;
+      std::memcpy(&r, buf.data() + pos, sizeof(r));
+      const size_t bytes = feed_t::paddedSize(r.size);
+      if(buf.size() - pos < bytes) break;
+      m.apply(r, std::span<const uint8_t>(buf.data() + pos + sizeof(r), r.size));
+      pos += bytes;
+    }
+    buf.erase(buf.begin(), buf.begin() + pos);
+  }
+  uint64_t report[2] = { m.frames, m.hash() };
+  return write(out, report, sizeof(report)) == sizeof(report) && buf.empty() ? 0 : 1;
+};
+
+int main(int argc, const char** argv) {
+  //fork before any threads exist
+  int feedPipe[2], reportPipe[2];
+  if(pipe(feedPipe) != 0 || pipe(reportPipe) != 0) [[unlikely]]
+    WITE_ERROR("pipe failed");
+  pid_t child = fork();
+  ASSERT_TRAP(child >= 0, "fork failed");
+  if(child == 0) {
+    close(feedPipe[1]);
+    close(reportPipe[0]);
+    return consumer(feedPipe[0], reportPipe[1]);
+  }
+  close(feedPipe[0]);
+  close(reportPipe[1]);
+  WITE::configuration::setOptions(argc, argv);
+  testGap();
+  std::filesystem::path dirPath = std::filesystem::temp_directory_path() / "wite_db_change_feed_test";
+  std::filesystem::remove_all(dirPath);
+  //consumed in process, checked every frame
+  {
+    db = std::make_unique<db_t>(dirPath / "local", true, true);
+    feed_t* feed = db->enableChangeFeed();
+    mirror m;
+    run(feed, [feed, &m](const std::set<uint64_t>& movers, uint64_t markerId) {
+      feed->consume([&m](const feed_t::record_t& r, std::span<const uint8_t> payload) { m.apply(r, payload); });
+      ASSERT_TRAP(m.objects == snapshot(movers, markerId).objects, "mirror does not match the database at frame ", m.frame);
+      ASSERT_TRAP(m.markerRecords == 1, "unchanged object was published again");
+    });
+    ASSERT_TRAP(m.frames == feed->getFramesPublished(), "frames missing from the feed");
+    db->gracefulShutdown();
+    db->deleteFiles();
+  }
+  //streamed to another process, which must end up with the same mirror
+  uint64_t expected[2];
+  {
+    db = std::make_unique<db_t>(dirPath / "streamed", true, true);
+    feed_t* feed = db->enableChangeFeed();
+    feed->streamTo(feedPipe[1]);
+    mirror m = run(feed, [](const std::set<uint64_t>&, uint64_t) {});
+    expected[0] = m.frames;
+    expected[1] = m.hash();
+    db->gracefulShutdown();//flushes and closes the pipe, so the consumer finishes
+    ASSERT_TRAP(!feed->isStreamBroken(), "consumer stopped reading");
+    db->deleteFiles();
+  }
+  uint64_t report[2];
+  if(read(reportPipe[0], report, sizeof(report)) != sizeof(report)) [[unlikely]]
+    WITE_ERROR("no report from consumer");
+  int status;
+  waitpid(child, &status, 0);
+  ASSERT_TRAP(WIFEXITED(status) && WEXITSTATUS(status) == 0, "consumer failed");
+  if(report[0] != expected[0] || report[1] != expected[1]) [[unlikely]]
+    WITE_ERROR("consumer saw ", report[0], " frames, expected ", expected[0]);
+  db.reset();
+  std::filesystem::remove_all(dirPath);
+  std::cout << "consumer mirrored " << report[0] << " frames\n";
+};
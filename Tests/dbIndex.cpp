@@ -189,6 +189,68 @@ int main(int argc, const char** argv) {
   time = getNs();
   WARN("post-rebalance 2 count check: ", (time - lastTime)/1000000);
   lastTime = time;
+  {//paginated walk over everything, in order
+    auto cursor = dbi->seek(std::numeric_limits<float>::lowest());
+    uint64_t total = 0, pages = 0;
+    float last = std::numeric_limits<float>::lowest();
+    while(uint64_t cnt = dbi->page(cursor, std::numeric_limits<float>::max(), 1000, [&last](float v, uint64_t) {
+      ASSERT_TRAP(!(v < last), "cursor went backward");
+      last = v;
+    })) {
+      total += cnt;
+      pages++;
+    }
+    ASSERT_TRAP(total == testSize*2, "paginated walk saw wrong number of entries: ", total);
+    ASSERT_TRAP(pages == (testSize*2 + 999)/1000, "wrong page count: ", pages);
+    //cursor at the end stays put and resumes when something new shows up
+    dbi->insert(WITE::NONE - 1, testSize*3);
+    ASSERT_TRAP(dbi->next(cursor) && cursor.target == WITE::NONE - 1, "cursor did not resume");
+    dbi->remove(testSize*3, WITE::NONE - 1);
+  }
+#ifdef DEBUG //these blocks only assert
+  {//seek and early exit
+    for(uint64_t i = 0;i < testSize*3;i += 3) {
+      auto cursor = dbi->seek(i / 5.0f);
+      uint64_t cnt = dbi->page(cursor, std::numeric_limits<float>::max(), 10, [](float, uint64_t) { return false; });
+      ASSERT_TRAP(cnt == 1 && cursor.value == i / 5.0f && cursor.target == i, "seek found the wrong thing", i);
+      ASSERT_TRAP(dbi->next(cursor) && cursor.target == i, "duplicate entry not visited", i);
+    }
+  }
+  {//top 10 by walking backward from the top
+    auto cursor = dbi->seekBack(std::numeric_limits<float>::max());
+    uint64_t expected = (testSize - 1) * 3;
+    for(uint64_t i = 0;i < 10;i++) {
+      ASSERT_TRAP(dbi->prev(cursor) && cursor.target == expected, "top-k wrong", i);
+      if(i % 2) expected -= 3;
+    }
+  }
+#endif
+  {
+    auto stats = dbi->getStats();
+    WARN("stats: entries: ", stats.entries, " height: ", stats.height, " visited per lookup: ", stats.visitedPerLookup());
+    ASSERT_TRAP(stats.entries == testSize*2 && !stats.degenerate(), "index stats wrong or index degenerated after rebalance");
+    ASSERT_TRAP(stats.histogram.size() == dbi->histogramBuckets + 1, "histogram missing after rebalance");
+#ifdef DEBUG
+    //the values are evenly distributed, so the estimate for half the range should be about half
+    uint64_t estimate = dbi->estimateCount(0, (testSize*3/2) / 5.0f);
+#endif
+    ASSERT_TRAP(estimate > testSize*2/4 && estimate < testSize*2*3/4, "estimate is way off: ", estimate);
+    ASSERT_TRAP(stats.histogramEntries == stats.entries, "histogram built from the wrong entry count: ", stats.histogramEntries);
+    ASSERT_TRAP(stats.lookups > 0 && stats.nodesVisited >= stats.lookups, "lookups not counted");
+    ASSERT_TRAP(!dbi->checkHealth(), "balanced index reported as degenerate");
+  }
+  {//sorted inserts with no rebalance degenerate the tree, which checkHealth notices and rebalance fixes
+    std::filesystem::path sortedPath = std::filesystem::temp_directory_path() / "wite_dbindex_sorted_test.wdb";
+    WITE::dbIndex<float> sorted(sortedPath, true);
+    for(uint64_t i = 0;i < 1000;i++)
+      sorted.insert(i, float(i));
+    ASSERT_TRAP(sorted.checkHealth() && sorted.getStats().degenerate(), "degenerate index not detected");
+    sorted.rebalance();
+    ASSERT_TRAP(!sorted.checkHealth() && sorted.getStats().height <= 2 * std::bit_width(uint64_t(1000)), "rebalance did not restore the height");
+  }
+  time = getNs();
+  WARN("cursor and stats check: ", (time - lastTime)/1000000);
+  lastTime = time;
   delete dbi;
 };
 
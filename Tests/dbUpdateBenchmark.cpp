@@ -0,0 +1,66 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include "../WITE/WITE.hpp"
+
+//measures frame time (updateTick + endFrame) against the number of objects with a trivial update, to show how dispatch overhead scales
+
+struct particle {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "particle";
+  static std::atomic_uint64_t updates;
+  float location = 0, velocity = 1;
+  static void update(uint64_t oid, void* db_unused);
+};
+
+typedef WITE::database<particle> db_t;
+std::unique_ptr<db_t> db;
+
+std::atomic_uint64_t particle::updates;
+
+void particle::update(uint64_t oid, void* db_unused) {
+  particle p;
+  updates.fetch_add(1, std::memory_order_relaxed);
+  if(!db->readCommitted<particle>(oid, &p)) [[unlikely]] return;
+  p.location += p.velocity;
+  db->write<particle>(oid, &p);
+};
+
+int main(int argc, const char** argv) {
+  WITE::configuration::setOptions(argc, argv);
+  std::filesystem::path dirPath = std::filesystem::temp_directory_path() / "wite_db_update_benchmark";
+  constexpr uint64_t warmupFrames = 5, frames = 20;
+  for(uint64_t objectCount = 1000;objectCount <= 1000000;objectCount *= 10) {
+    db = std::make_unique<db_t>(dirPath.string(), true, true);
+    particle p;
+    for(uint64_t i = 0;i < objectCount;i++)
+      db->create<particle>(&p);
+    for(uint64_t i = 0;i < warmupFrames;i++) {
+      db->updateTick();
+      db->endFrame();
+    }
+    particle::updates = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for(uint64_t i = 0;i < frames;i++) {
+      db->updateTick();
+      db->endFrame();
+    }
+    const uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    ASSERT_TRAP(particle::updates == objectCount * frames, "wrong number of updates: ", particle::updates);
+    std::cout << "objects: " << objectCount << " \tframe time (ns): " << time / frames << " \tper object (ns): " << time / (frames * objectCount) << "\n";
+    db->gracefulShutdown();
+    db->deleteFiles();
+    db.reset();
+  }
+};
@@ -0,0 +1,100 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <vector>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//lock sites count what they should. Only meaningful in a -DWITE_LOCK_PROFILE build, otherwise there is nothing to check.
+
+#ifdef WITE_LOCK_PROFILE
+
+constexpr size_t threadCount = 4, holdsPerThread = 50;
+constexpr uint64_t holdNs = 100000;
+
+void check(const char* name, const lockSite::counts_t& c, uint64_t acquisitions, bool expectContention) {
+  std::cout << name << ": " << c.acquisitions.load() << " acquisitions, " << c.contended.load() << " contended, waited " << c.waitNs.load() / 1000 << "us, held " << c.holdNs.load() / 1000 << "us\n";
+  if(c.acquisitions.load() != acquisitions) [[unlikely]]
+    WITE_ERROR("wrong acquisition count at ", name);
+  if(c.holdNs.load() < acquisitions * holdNs) [[unlikely]]
+    WITE_ERROR("hold time too short at ", name);
+  if(expectContention && (!c.contended.load() || !c.waitNs.load())) [[unlikely]]
+    WITE_ERROR("no contention recorded at ", name);
+  if(c.maxWaitNs.load() > c.waitNs.load() || c.maxHoldNs.load() > c.holdNs.load()) [[unlikely]]
+    WITE_ERROR("max exceeds total at ", name);
+};
+
+void hammer(auto f) {
+  std::vector<thread*> threads;
+  for(size_t t = 0;t < threadCount;t++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([f]() {
+      for(size_t i = 0;i < holdsPerThread;i++)
+	f();
+    })));
+  for(thread* t : threads)
+    t->join();
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  syncLock plain { "test::syncLock" };
+  hammer([&plain]() {
+    scopeLock l(&plain);
+    thread::sleep(holdNs);
+  });
+  check("syncLock", lockSite::get("test::syncLock")->exclusive, threadCount * holdsPerThread, true);
+  //readers all overlap, so there is only contention when a writer is involved
+  concurrentReadSyncLock rw { "test::concurrentReadSyncLock" };
+  std::atomic_uint64_t opIdx = 0;
+  hammer([&rw, &opIdx]() {
+    if(opIdx++ % 5) {
+      concurrentReadLock_read l(&rw);
+      thread::sleep(holdNs);
+    } else {
+      concurrentReadLock_write l(&rw);
+      thread::sleep(holdNs);
+    }
+  });
+  const lockSite* rwSite = lockSite::get("test::concurrentReadSyncLock");
+  constexpr uint64_t writes = threadCount * holdsPerThread / 5;
+  check("concurrentReadSyncLock write", rwSite->exclusive, writes, true);
+  check("concurrentReadSyncLock read", rwSite->shared, threadCount * holdsPerThread - writes, false);
+  //reentrant holds count once
+  advancedSyncLock advanced { "test::advancedSyncLock" };
+  hammer([&advanced]() {
+    advancedScopeLock outer(advanced);
+    advancedScopeLock inner(advanced);
+    thread::sleep(holdNs);
+  });
+  check("advancedSyncLock", lockSite::get("test::advancedSyncLock")->exclusive, threadCount * holdsPerThread, true);
+  //sites are shared by name, and unnamed locks are not profiled
+  syncLock other { "test::syncLock" }, unnamed;
+  {
+    scopeLock l(&other);
+    scopeLock l2(&unnamed);
+    thread::sleep(holdNs);
+  }
+  check("syncLock shared by name", lockSite::get("test::syncLock")->exclusive, threadCount * holdsPerThread + 1, true);
+  profiler::printLockData(std::cout);
+};
+
+#else
+
+int main(int argc, const char** argv) {
+  std::cout << "built without WITE_LOCK_PROFILE, nothing to check\n";
+};
+
+#endif
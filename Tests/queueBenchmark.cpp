@@ -0,0 +1,138 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//throughput of the bounded queues at several producer and consumer counts, and round trip latency between two threads, each against a locked std::queue of the same capacity
+
+constexpr uint64_t capacity = 1024, itemsPerRun = 4000000, roundTrips = 100000;
+
+//what these queues replaced
+template<class T, size_t CAPACITY> struct lockedQueue {
+  syncLock lock;
+  std::queue<T> q;
+  bool push(const T& t) {
+    scopeLock l(&lock);
+    if(q.size() == CAPACITY) return false;
+    q.push(t);
+    return true;
+  };
+  bool pop(T& out) {
+    scopeLock l(&lock);
+    if(q.empty()) return false;
+    out = q.front();
+    q.pop();
+    return true;
+  };
+};
+
+//millions of items per second
+template<class Q> double throughput(size_t producers, size_t consumers) {
+  Q q;
+  std::atomic_bool go = false;
+  std::atomic_uint64_t popped = 0, sum = 0;
+  const uint64_t perProducer = itemsPerRun / producers, total = perProducer * producers;
+  std::vector<thread*> threads;
+  for(size_t p = 0;p < producers;p++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&]() {
+      while(!go.load(std::memory_order_acquire)) thread::sleepShort();
+      uint32_t sleepCnt = 0;
+      for(uint64_t i = 1;i <= perProducer;i++) {
+	while(!q.push(i))
+	  thread::sleepShort(sleepCnt);
+	sleepCnt = 0;
+      }
+    })));
+  for(size_t c = 0;c < consumers;c++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&]() {
+      while(!go.load(std::memory_order_acquire)) thread::sleepShort();
+      uint32_t sleepCnt = 0;
+      uint64_t v, mySum = 0;
+      while(popped.load(std::memory_order_relaxed) < total) {
+	if(q.pop(v)) {
+	  mySum += v;
+	  popped.fetch_add(1, std::memory_order_relaxed);
+	  sleepCnt = 0;
+	} else {
+	  thread::sleepShort(sleepCnt);
+	}
+      }
+      sum.fetch_add(mySum);
+    })));
+  const auto start = std::chrono::steady_clock::now();
+  go = true;
+  for(thread* t : threads)
+    t->join();
+  const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  if(sum.load() != producers * perProducer * (perProducer + 1) / 2) [[unlikely]]
+    WITE_ERROR("items lost or duplicated");
+  return total * 1000.0 / elapsed;
+};
+
+//one thread sends, the other echoes back on a second queue. Returns median and 99th percentile round trip ns.
+template<class Q> std::pair<uint64_t, uint64_t> latency() {
+  Q there, back;
+  std::atomic_bool stop = false;
+  thread* echo = thread::spawnThread(thread::threadEntry_t_F::make([&]() {
+    uint32_t sleepCnt = 0;
+    uint64_t v;
+    while(!stop.load(std::memory_order_relaxed)) {
+      if(there.pop(v)) {
+	while(!back.push(v));
+	sleepCnt = 0;
+      } else {
+	thread::sleepShort(sleepCnt);
+      }
+    }
+  }));
+  std::vector<uint64_t> samples(roundTrips);
+  uint64_t v;
+  for(uint64_t i = 0;i < roundTrips;i++) {
+    uint32_t sleepCnt = 0;
+    const auto start = std::chrono::steady_clock::now();
+    there.push(i);
+    while(!back.pop(v))
+      thread::sleepShort(sleepCnt);
+    samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    if(v != i) [[unlikely]]
+      WITE_ERROR("echo out of order");
+  }
+  stop = true;
+  echo->join();
+  std::sort(samples.begin(), samples.end());
+  return { samples[roundTrips / 2], samples[roundTrips * 99 / 100] };
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  typedef lockedQueue<uint64_t, capacity> locked;
+  std::cout << "Mitems/s\tqueue\tlocked\n";
+  std::cout << "spsc 1:1\t" << throughput<spscQueue<uint64_t, capacity>>(1, 1) << "\t" << throughput<locked>(1, 1) << "\n";
+  for(size_t p = 1;p <= 8;p *= 2)
+    std::cout << "mpsc " << p << ":1\t" << throughput<mpscQueue<uint64_t, capacity>>(p, 1) << "\t" << throughput<locked>(p, 1) << "\n";
+  for(size_t n = 1;n <= 8;n *= 2)
+    std::cout << "mpmc " << n << ":" << n << "\t" << throughput<mpmcQueue<uint64_t, capacity>>(n, n) << "\t" << throughput<locked>(n, n) << "\n";
+  std::cout << "round trip ns\tmedian\tp99\n";
+  auto print = [](const char* name, std::pair<uint64_t, uint64_t> r) { std::cout << name << "\t" << r.first << "\t" << r.second << "\n"; };
+  print("spsc", latency<spscQueue<uint64_t, capacity>>());
+  print("mpsc", latency<mpscQueue<uint64_t, capacity>>());
+  print("mpmc", latency<mpmcQueue<uint64_t, capacity>>());
+  print("locked", latency<locked>());
+};
@@ -0,0 +1,115 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <algorithm>
+#include <shared_mutex>
+#include <vector>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//throughput and worst writer wait of concurrentReadSyncLock under contention, against std::shared_mutex
+
+volatile uint64_t sink;
+
+void spin() {
+  for(size_t i = 0;i < 20;i++)
+    sink = sink + i;
+};
+
+//two halves that a writer keeps equal, and a little work inside the lock so holds overlap
+struct guarded_t {
+  uint64_t a = 0, b = 0;
+  std::atomic_uint32_t writers = 0;
+  std::atomic_bool torn = false;
+  void read() {
+    const uint64_t x = a;
+    spin();
+    if(x != b || writers.load(std::memory_order_relaxed)) [[unlikely]] torn = true;
+  };
+  void write() {
+    if(writers.fetch_add(1, std::memory_order_relaxed)) [[unlikely]] torn = true;
+    a++;
+    spin();
+    b++;
+    writers.fetch_sub(1, std::memory_order_relaxed);
+  };
+};
+
+struct wite_t {
+  concurrentReadSyncLock l;
+  void read(guarded_t& g) { concurrentReadLock_read r(&l); g.read(); };
+  void write(guarded_t& g) { concurrentReadLock_write w(&l); g.write(); };
+};
+
+struct std_t {
+  std::shared_mutex l;
+  void read(guarded_t& g) { std::shared_lock r(l); g.read(); };
+  void write(guarded_t& g) { std::unique_lock w(l); g.write(); };
+};
+
+constexpr size_t opsPerThread = 20000;
+
+struct result_t {
+  double mops;
+  uint64_t worstWriteNs;
+};
+
+//every thread does the same mix: one write in every readsPerWrite+1 ops
+template<class L> result_t run(size_t threadCount, size_t readsPerWrite) {
+  L lock;
+  guarded_t data;
+  std::atomic_uint64_t worstWrite = 0;
+  std::atomic_bool go = false;
+  std::vector<thread*> threads;
+  for(size_t t = 0;t < threadCount;t++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&, t]() {
+      while(!go.load(std::memory_order_acquire)) thread::sleepShort();
+      uint64_t worst = 0;
+      for(size_t i = 0;i < opsPerThread;i++) {
+	if((i + t) % (readsPerWrite + 1)) {
+	  lock.read(data);
+	} else {
+	  const auto start = std::chrono::steady_clock::now();
+	  lock.write(data);
+	  worst = max<uint64_t>(worst, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+      }
+      uint64_t old = worstWrite.load();
+      while(old < worst && !worstWrite.compare_exchange_weak(old, worst));
+    })));
+  const auto start = std::chrono::steady_clock::now();
+  go = true;
+  for(thread* t : threads)
+    t->join();
+  const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  if(data.torn) [[unlikely]]
+    WITE_ERROR("reader saw a write in progress, or two writers overlapped");
+  if(data.a != data.b) [[unlikely]]
+    WITE_ERROR("lost a write");
+  return { double(threadCount * opsPerThread) * 1000 / elapsed, worstWrite.load() };
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  const size_t ratios[] = { 1000, 100, 10, 1, 0 };
+  std::cout << "threads\treads:write\tWITE Mops\tstd Mops\tWITE worst write us\tstd worst write us\n";
+  for(size_t threadCount = 1;threadCount <= 64;threadCount *= 2) {
+    for(size_t ratio : ratios) {
+      const result_t w = run<wite_t>(threadCount, ratio), s = run<std_t>(threadCount, ratio);
+      std::cout << threadCount << "\t" << ratio << ":1\t\t" << w.mops << "\t\t" << s.mops << "\t\t" << w.worstWriteNs / 1000 << "\t\t\t" << s.worstWriteNs / 1000 << "\n";
+    }
+  }
+};
@@ -0,0 +1,147 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <filesystem>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//coroutine tasks on the thread pool and the database
+
+typedef threadPool::lane_e lane_e;
+
+//awaiting a task runs it inline, so deep chains of them must not grow the stack
+task<uint64_t> fib(uint64_t n) {
+  if(n < 2) co_return n;
+  const uint64_t a = co_await fib(n - 1);
+  co_return a + co_await fib(n - 2);
+};
+
+task<> counted(std::atomic_uint64_t* total, threadPool::counter_t* gate) {
+  co_await task<>::after(*gate);
+  co_await task<>::resumeIn(lane_e::eBackground);
+  if(threadPool::currentLane() != lane_e::eBackground) [[unlikely]]
+    WITE_ERROR("resumed in the wrong lane");
+  (*total)++;
+};
+
+task<> fileRoundTrip(std::filesystem::path path, bool* ok) {
+  const char out[] = "written from a task";
+  char in[sizeof(out)] {};
+  const uint64_t wrote = co_await task<>::writeFile(path, 100, out, sizeof(out));
+  const uint64_t read = co_await task<>::readFile(path, 100, in, sizeof(in));
+  const int blocked = co_await task<>::blocking([]() { thread::sleep(1000000); return 5; });
+  *ok = wrote == sizeof(out) && read == sizeof(in) && std::memcmp(in, out, sizeof(out)) == 0 && blocked == 5;
+};
+
+void testPool() {
+  threadPool pool(2);
+  //result from a chain of awaited tasks
+  {
+    threadPool::counter_t done;
+    uint64_t result = 0;
+    [](uint64_t* out) -> task<> { *out = co_await fib(20); }(&result).spawn(pool, &done);
+    pool.wait(done);
+    if(result != 6765) [[unlikely]]
+      WITE_ERROR("fib(20) = ", result);
+  }
+  //suspended tasks hold no worker: with both workers' worth of tasks waiting on a gate, other jobs still run
+  {
+    threadPool::counter_t gate, tasks, other;
+    std::atomic_uint64_t total = 0;
+    pool.hold(gate);
+    for(size_t i = 0;i < 50;i++)
+      counted(&total, &gate).spawn(pool, &tasks);
+    std::atomic_bool ran = false;
+    threadPool::job_t j { threadPool::jobEntry_t_F::make([&ran](threadPool::jobData_t&) { ran = true; }), {} };
+    pool.submitJob(&j, &other);
+    pool.wait(other);
+    if(!ran || total.load() || tasks.done()) [[unlikely]]
+      WITE_ERROR("tasks ran before their gate opened, or blocked the pool");
+    pool.release(gate);
+    pool.wait(tasks);
+    if(total.load() != 50) [[unlikely]]
+      WITE_ERROR("only ", total.load(), " tasks finished");
+  }
+  //io off the pool
+  {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "wite_task_test.bin";
+    std::filesystem::remove(path);
+    threadPool::counter_t done;
+    bool ok = false;
+    fileRoundTrip(path, &ok).spawn(pool, &done);
+    pool.wait(done);
+    std::filesystem::remove(path);
+    if(!ok) [[unlikely]]
+      WITE_ERROR("file round trip through a task failed");
+  }
+};
+
+struct ticker {
+  static constexpr uint64_t typeId = __LINE__;
+  static constexpr std::string dbFileId = "ticker";
+  uint64_t value = 0;
+};
+
+typedef database<ticker> db_t;
+
+//waits on frames, checking it is resumed in the frame it should be and can write there
+task<> frameWatcher(db_t* db, uint64_t oid, std::vector<uint64_t>* frames) {
+  for(size_t i = 0;i < 3;i++) {
+    co_await db->nextFrame();
+    frames->push_back(db->getFrame());
+    ticker t { frames->back() };
+    db->write<ticker>(oid, &t);
+  }
+  const uint64_t target = db->getFrame() + 5;
+  co_await db->frameCommitted(target);
+  frames->push_back(db->getFrame());
+  co_await db->frameCommitted(target);//already committed, doesn't suspend
+  frames->push_back(db->getFrame());
+};
+
+void testDatabase() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "wite_task_test_db";
+  std::filesystem::remove_all(dir);
+  db_t db(dir, true, true);
+  ticker t;
+  const uint64_t oid = db.create<ticker>(&t);
+  db.updateTick();
+  db.endFrame();
+  const uint64_t start = db.getFrame();
+  std::vector<uint64_t> frames;
+  threadPool::counter_t done;
+  db.spawn(frameWatcher(&db, oid, &frames), &done);
+  for(size_t i = 0;i < 12;i++) {
+    db.updateTick();
+    db.endFrame();
+  }
+  if(!done.done()) [[unlikely]]
+    WITE_ERROR("frame watcher still waiting");
+  const std::vector<uint64_t> expected { start + 1, start + 2, start + 3, start + 9, start + 9 };
+  if(frames != expected) [[unlikely]]
+    WITE_ERROR("frame watcher resumed in the wrong frames");
+  ticker got;
+  if(!db.readCommitted<ticker>(oid, &got) || got.value != start + 3) [[unlikely]]
+    WITE_ERROR("write from a resumed task was lost");
+  db.gracefulShutdown();
+  std::filesystem::remove_all(dir);
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  testPool();
+  testDatabase();
+};
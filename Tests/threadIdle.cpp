@@ -0,0 +1,105 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//cpu used by an idle pool and by threads blocked on locks, and how long a parked thread takes to wake
+
+std::atomic<std::chrono::steady_clock::time_point> startedAt;
+
+uint64_t cpuNs() {
+  rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return (r.ru_utime.tv_sec + r.ru_stime.tv_sec) * 1000000000ull + (r.ru_utime.tv_usec + r.ru_stime.tv_usec) * 1000ull;
+};
+
+//fraction of one core the process used while f ran
+double cpuShare(auto f) {
+  const uint64_t cpu = cpuNs();
+  const auto wall = std::chrono::steady_clock::now();
+  f();
+  return double(cpuNs() - cpu) / std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wall).count();
+};
+
+void stampJob(threadPool::jobData_t&) {
+  startedAt.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  threadPool pool(max(2, thread::guessCpuCount() - 2));
+  std::cout << pool.getThreadCount() << " workers, spin budget " << thread::spinBudget.load() << ", yield budget " << thread::yieldBudget.load() << "\n";
+  //idle pool
+  thread::sleepSeconds(0.1f);
+  const double idle = cpuShare([]() { thread::sleepSeconds(1); });
+  std::cout << "idle pool used " << idle * 100 << "% of a core\n";
+  if(idle > 0.25) [[unlikely]]
+    WITE_ERROR("idle pool is burning cpu");
+  //wake latency: submit to a pool that has had time to park
+  threadPool::job_t stamp { threadPool::jobEntry_t_F::make(&stampJob), {} };
+  std::vector<uint64_t> latencies;
+  for(size_t i = 0;i < 100;i++) {
+    thread::sleep(5000000);
+    const auto submitted = std::chrono::steady_clock::now();
+    pool.submitJob(&stamp);
+    pool.waitForAll();
+    latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(startedAt.load(std::memory_order_relaxed) - submitted).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << "wake latency from parked: median " << latencies[50] / 1000 << "us, p99 " << latencies[99] / 1000 << "us\n";
+  //back to back, so nobody has parked
+  latencies.clear();
+  for(size_t i = 0;i < 1000;i++) {
+    const auto submitted = std::chrono::steady_clock::now();
+    pool.submitJob(&stamp);
+    pool.waitForAll();
+    latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(startedAt.load(std::memory_order_relaxed) - submitted).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << "wake latency when busy: median " << latencies[500] / 1000 << "us, p99 " << latencies[990] / 1000 << "us\n";
+  //threads waiting on a lock that is held for a long time
+  syncLock lock;
+  concurrentReadSyncLock rwLock;
+  lock.WaitForLock();
+  rwLock.acquireWrite();
+  std::atomic<std::chrono::steady_clock::time_point> releasedAt, wokeAt;
+  std::vector<thread*> waiters;
+  for(size_t i = 0;i < 2;i++) {
+    waiters.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&lock, &wokeAt]() {
+      scopeLock l(&lock);
+      std::chrono::steady_clock::time_point first;
+      wokeAt.compare_exchange_strong(first, std::chrono::steady_clock::now());
+    })));
+    waiters.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&rwLock]() {
+      concurrentReadLock_read l(&rwLock);
+    })));
+  }
+  thread::sleepSeconds(0.1f);
+  const double waiting = cpuShare([]() { thread::sleepSeconds(1); });
+  std::cout << "4 threads blocked on locks used " << waiting * 100 << "% of a core\n";
+  releasedAt = std::chrono::steady_clock::now();
+  lock.ReleaseLock();
+  rwLock.releaseWrite();
+  for(thread* t : waiters)
+    t->join();
+  std::cout << "lock hand off to a parked waiter took " << std::chrono::duration_cast<std::chrono::microseconds>(wokeAt.load() - releasedAt.load()).count() << "us\n";
+  if(waiting > 0.25) [[unlikely]]
+    WITE_ERROR("blocked threads are burning cpu");
+};
@@ -0,0 +1,227 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <set>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+std::unique_ptr<threadPool> pool;
+std::atomic_uint64_t ran;
+syncLock tidsMutex;
+std::set<tid_t> childTids;
+
+void busy(uint64_t ns) {
+  auto end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+  while(std::chrono::steady_clock::now() < end);
+};
+
+void countJob(threadPool::jobData_t& data) {
+  busy(data[0]);
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+void childJob(threadPool::jobData_t& data) {
+  ASSERT_TRAP(pool->onMemberThread(), "job not on a member thread");
+  busy(data[0]);
+  {
+    scopeLock l(&tidsMutex);
+    childTids.insert(thread::getCurrentTid());
+  }
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+//submits its children from inside the pool, so they go to this worker's own deque (and past it, once it's full)
+void parentJob(threadPool::jobData_t& data) {
+  static const threadPool::job_t child { threadPool::jobEntry_t_F::make(&childJob), {} };
+  threadPool::job_t j = child;
+  j.data[0] = data[1];
+  for(uint64_t i = 0;i < data[0];i++)
+    pool->submitJob(&j);
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+std::atomic_uint64_t ranBeforeContinuation;
+
+void continuationJob(threadPool::jobData_t&) {
+  ranBeforeContinuation = ran.load();
+};
+
+//binary fork/join from inside the pool: every level blocks a worker in wait() while its children run
+uint64_t forkSum(uint64_t depth) {
+  if(!depth) return 1;
+  std::atomic_uint64_t sum = 0;
+  pool->parallelFor(0, 2, [&sum, depth](uint64_t b, uint64_t e) {
+    for(uint64_t i = b;i < e;i++)
+      sum.fetch_add(forkSum(depth - 1), std::memory_order_relaxed);
+  }, 1);
+  return sum;
+};
+
+void forkJob(threadPool::jobData_t& data) {
+  data[1] = forkSum(data[0]);
+  if(data[1] != uint64_t(1) << data[0]) [[unlikely]]
+    WITE_ERROR("fork/join lost work: ", data[1]);
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+std::atomic_uint64_t started, backgroundRunning, backgroundMax, lastCriticalStart;
+
+void laneJob(threadPool::jobData_t& data) {
+  const uint64_t order = started.fetch_add(1, std::memory_order_relaxed);
+  const bool background = threadPool::currentLane() == threadPool::lane_e::eBackground;
+  if(background)
+    atomicMax(backgroundMax, backgroundRunning.fetch_add(1, std::memory_order_relaxed) + 1);
+  if(threadPool::currentLane() == threadPool::lane_e::eFrameCritical)
+    atomicMax(lastCriticalStart, order);
+  busy(data[0]);
+  if(background)
+    backgroundRunning.fetch_sub(1, std::memory_order_relaxed);
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+//background work that forks more background work must not stall on the cap it already holds
+void nestedBackgroundJob(threadPool::jobData_t&) {
+  std::atomic_uint64_t sum = 0;
+  pool->parallelFor(0, 64, [&sum](uint64_t b, uint64_t e) {
+    ASSERT_TRAP(threadPool::currentLane() == threadPool::lane_e::eBackground, "parallelFor chunk did not inherit its lane");
+    busy(10000);
+    sum.fetch_add(e - b, std::memory_order_relaxed);
+  }, 1);
+  if(sum != 64) [[unlikely]]
+    WITE_ERROR("nested background parallelFor lost work");
+  ran.fetch_add(1, std::memory_order_relaxed);
+};
+
+uint64_t timeNs(auto f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  //cpu lists are the /sys and taskset format, anything else is rejected whole
+  if(thread::parseCpuList("0-2,5,7-8\n") != std::vector<uint32_t> { 0, 1, 2, 5, 7, 8 }) [[unlikely]]
+    WITE_ERROR("cpu list parsed wrong");
+  for(const char* bad : { "3-1", "0,", "1-", "x", "0;1", "-1", " 1", "99999999999" })
+    if(!thread::parseCpuList(bad).empty()) [[unlikely]]
+      WITE_ERROR("invalid cpu list accepted: ", bad);
+  pool = std::make_unique<threadPool>(max(2, thread::guessCpuCount() - 2));
+  const uint64_t threads = pool->getThreadCount();
+  threadPool::job_t counter { threadPool::jobEntry_t_F::make(&countJob), {} };
+  //many small jobs from outside the pool, more than the shared queue can hold at once
+  ran = 0;
+  for(uint64_t i = 0;i < 100000;i++)
+    pool->submitJob(&counter);
+  pool->waitForAll();
+  ASSERT_TRAP(ran == 100000, "lost jobs: ", ran);
+  ASSERT_TRAP(!pool->onMemberThread(), "main thread is not a member");
+  //nested: each parent's children start in its own deque, so any other thread that ran one stole it
+  threadPool::job_t parent { threadPool::jobEntry_t_F::make(&parentJob), { 1000, 20000 } };
+  ran = 0;
+  pool->submitJob(&parent);
+  pool->waitForAll();
+  ASSERT_TRAP(ran == 1001, "lost nested jobs: ", ran);
+  ASSERT_TRAP(childTids.size() > 1, "nothing was stolen");
+  std::cout << "1000 children of one job ran on " << childTids.size() << " of " << threads << " threads\n";
+  //more children than a deque can hold
+  parent.data[0] = 10000;
+  parent.data[1] = 0;
+  ran = 0;
+  for(uint64_t i = 0;i < 4;i++)
+    pool->submitJob(&parent);
+  pool->waitForAll();
+  ASSERT_TRAP(ran == 40004, "lost overflowing nested jobs: ", ran);
+  //counters and continuations: the continuation waits for every job of the first group, and the second group counts it
+  {
+    threadPool::counter_t first, second;
+    threadPool::job_t cont { threadPool::jobEntry_t_F::make(&continuationJob), {} };
+    counter.data[0] = 1000;
+    ran = 0;
+    for(uint64_t i = 0;i < 1000;i++)
+      pool->submitJob(&counter, &first);
+    pool->then(first, &cont, &second);
+    pool->wait(second);
+    ASSERT_TRAP(first.done(), "continuation finished before its predecessors");
+    ASSERT_TRAP(ranBeforeContinuation == 1000, "continuation started early: ", ranBeforeContinuation);
+    //continuing a counter that is already done runs at once
+    ranBeforeContinuation = 0;
+    pool->then(first, &cont, &second);
+    pool->wait(second);
+    ASSERT_TRAP(ranBeforeContinuation == 1000, "continuation of a done counter did not run");
+  }
+  //parallelFor, from outside the pool
+  {
+    std::atomic_uint64_t sum = 0;
+    const uint64_t n = 1000000;
+    pool->parallelFor(0, n, [&sum](uint64_t b, uint64_t e) {
+      uint64_t s = 0;
+      for(uint64_t i = b;i < e;i++)
+	s += i;
+      sum.fetch_add(s, std::memory_order_relaxed);
+    });
+    ASSERT_TRAP(sum == n * (n - 1) / 2, "parallelFor sum wrong: ", sum);
+  }
+  //nested fork/join inside many jobs at once, so that every worker ends up waiting on its own children
+  threadPool::job_t fork { threadPool::jobEntry_t_F::make(&forkJob), { 10 } };
+  ran = 0;
+  for(uint64_t i = 0;i < threads * 4;i++)
+    pool->submitJob(&fork);
+  pool->waitForAll();
+  ASSERT_TRAP(ran == threads * 4, "lost fork/join jobs: ", ran);
+  //lanes: frame-critical work queued behind a pile of normal and background work still goes first, and background work stays under its cap
+  {
+    const uint64_t cap = max(1u, static_cast<uint32_t>(threads * configuration::getOption("backgroundshare", 0.25f) + 0.5f));
+    threadPool::job_t normal { threadPool::jobEntry_t_F::make(&laneJob), { 500000 } }, background = normal, critical = normal;
+    background.lane = threadPool::lane_e::eBackground;
+    critical.lane = threadPool::lane_e::eFrameCritical;
+    started = backgroundRunning = backgroundMax = lastCriticalStart = ran = 0;
+    for(uint64_t i = 0;i < 100;i++) {
+      pool->submitJob(&background);
+      pool->submitJob(&normal);
+    }
+    for(uint64_t i = 0;i < 10;i++)
+      pool->submitJob(&critical);
+    pool->waitForLane(threadPool::lane_e::eFrameCritical);
+    const uint64_t doneAtCritical = ran;
+    pool->waitForAll();
+    ASSERT_TRAP(ran == 210, "lost lane jobs: ", ran);
+    std::cout << "10 frame-critical jobs submitted behind 200 others all started within the first " << lastCriticalStart + 1 << " jobs, " << doneAtCritical << " done when they were\n";
+    ASSERT_TRAP(lastCriticalStart < 50, "frame-critical jobs did not jump the queue");
+    if(backgroundMax > cap) [[unlikely]]
+      WITE_ERROR("background cap ", cap, " exceeded: ", backgroundMax);
+    //nested background forks, more of them than the cap
+    threadPool::job_t nested { threadPool::jobEntry_t_F::make(&nestedBackgroundJob), {}, threadPool::lane_e::eBackground };
+    ran = 0;
+    for(uint64_t i = 0;i < threads * 2;i++)
+      pool->submitJob(&nested);
+    pool->waitForAll();
+    ASSERT_TRAP(ran == threads * 2, "lost nested background jobs: ", ran);
+  }
+  //uneven costs: one expensive job among many cheap ones should not hold up the cheap ones queued behind it
+  const uint64_t cheap = 50000, expensive = 20000000, count = threads * 200;
+  uint64_t ns = timeNs([&]() {
+    counter.data[0] = expensive;
+    pool->submitJob(&counter);
+    counter.data[0] = cheap;
+    for(uint64_t i = 0;i < count;i++)
+      pool->submitJob(&counter);
+    pool->waitForAll();
+  });
+  const uint64_t ideal = max(expensive, (expensive + cheap * count) / threads);
+  std::cout << "uneven batch took " << ns / 1000 << "us, ideal " << ideal / 1000 << "us\n";
+  pool.reset();
+};
@@ -0,0 +1,94 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <vector>
+#include <map>
+
+#include "../WITE/WITE.hpp"
+
+using namespace WITE;
+
+//cost of a per thread lookup, the way gpu::getTempCmd does them, against the locked map threadResource used to be
+
+//stands in for cmdPool
+struct pool_t {
+  uint64_t allocated = 0;
+  uint64_t allocate() { return ++allocated; };
+};
+
+//threadResource as it was: a lock and a map, keyed by system thread id
+struct lockedResource_t {
+  syncLock lock;
+  std::map<tid_t, std::unique_ptr<pool_t>> data;
+  pool_t* get() {
+    scopeLock l(&lock);
+    auto& d = data[thread::getCurrentTid()];
+    if(!d) d.reset(new pool_t());
+    return d.get();
+  };
+};
+
+constexpr uint64_t opsPerThread = 1000000;
+
+//ns per lookup, averaged over all threads
+template<class R> double run(R& resource, size_t threadCount) {
+  std::atomic_bool go = false;
+  std::atomic_uint64_t bad = 0;
+  std::vector<thread*> threads;
+  for(size_t t = 0;t < threadCount;t++)
+    threads.push_back(thread::spawnThread(thread::threadEntry_t_F::make([&]() {
+      while(!go.load(std::memory_order_acquire)) thread::sleepShort();
+      const uint64_t first = resource.get()->allocate();
+      uint64_t last = first;
+      for(uint64_t i = 1;i < opsPerThread;i++)
+	last = resource.get()->allocate();
+      if(last - first != opsPerThread - 1) [[unlikely]] bad++;
+    })));
+  const auto start = std::chrono::steady_clock::now();
+  go = true;
+  for(thread* t : threads)
+    t->join();
+  const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  if(bad.load()) [[unlikely]]
+    WITE_ERROR("two threads shared a per thread entry");
+  return double(elapsed) / (threadCount * opsPerThread);
+};
+
+int main(int argc, const char** argv) {
+  configuration::setOptions(argc, argv);
+  std::cout << "threads\tthreadResource ns/op\tlocked map ns/op\n";
+  for(size_t threadCount = 1;threadCount <= 64;threadCount *= 2) {
+    //fresh resources each round, so entry creation is included as it would be for new threads
+    threadResource<pool_t> fast;
+    lockedResource_t locked;
+    const double f = run(fast, threadCount), l = run(locked, threadCount);
+    std::cout << threadCount << "\t" << f << "\t\t\t" << l << "\n";
+  }
+  //indices of joined threads are reused, so a steady churn of threads does not grow every threadResource
+  threadResource<pool_t> churned;
+  for(size_t i = 0;i < 1000;i++) {
+    thread* a = thread::spawnThread(thread::threadEntry_t_F::make([&churned]() { churned.get()->allocate(); }));
+    thread* b = thread::spawnThread(thread::threadEntry_t_F::make([&churned]() { churned.get()->allocate(); }));
+    a->join();
+    b->join();
+  }
+  uint64_t entries = 0, total = 0;
+  for(pool_t& p : churned) {
+    entries++;
+    total += p.allocated;
+  }
+  std::cout << "2000 short lived threads left " << entries << " entries\n";
+  if(entries > 4 || total != 2000) [[unlikely]]
+    WITE_ERROR("thread indices were not reused, or entries were lost");
+};
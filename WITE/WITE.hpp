@@ -28,5 +28,8 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include "synth.hpp"
 #include "shutdown.hpp"
 #include "configuration.hpp"
+#include "advancedSyncLock.hpp"
+#include "boundedQueue.hpp"
 #include "database.hpp"
 #include "dbIndex.hpp"
+#include "dbReplica.hpp"
@@ -26,17 +26,30 @@ namespace WITE {
   };
 
   bool advancedSyncLock::acquire(uint64_t timeoutNS) {
-    auto endTime = std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNS);
+    //clamp, so the default (~0) means forever rather than overflowing into the past
+    auto endTime = timeoutNS >= uint64_t(std::chrono::steady_clock::duration::max().count() / 2) ?
+      std::chrono::steady_clock::time_point::max() :
+      std::chrono::steady_clock::now() + std::chrono::nanoseconds(timeoutNS);
     auto tid = thread::getCurrentTid();
     uint32_t sleepCnt = 0;
+#ifdef WITE_LOCK_PROFILE
+    const uint64_t waitStart = site ? lockSite::now() : 0;
+    bool contended = false;
+#endif
     do {
       scopeLock lock(&mutex);
       if(holds == 0 || currentOwner == tid) {
+#ifdef WITE_LOCK_PROFILE
+	if(site && holds == 0) heldSince = lockSite::acquired(site->exclusive, waitStart, contended);//reentrant holds are not acquisitions
+#endif
 	currentOwner = tid;
 	holds++;
 	return true;
       }
       lock.release();
+#ifdef WITE_LOCK_PROFILE
+      contended = true;
+#endif
       if(timeoutNS > 0)
 	thread::sleepShort(sleepCnt);
     } while(std::chrono::steady_clock::now() < endTime);
@@ -51,6 +64,9 @@ namespace WITE {
     ASSERT_TRAP(currentOwner == tid, "Mutex Failure!!! tid: ", tid, " owner: ", currentOwner, " holds: ", holds);
 #endif
     --holds;
+#ifdef WITE_LOCK_PROFILE
+    if(site && holds == 0) lockSite::released(site->exclusive, heldSince);
+#endif
   };
 
   bool advancedSyncLock::heldBy(tid_t tid) {
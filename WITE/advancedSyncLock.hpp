@@ -23,9 +23,18 @@ namespace WITE {
   private:
     syncLock mutex;
     tid_t currentOwner;
-    uint32_t holds;
+    uint32_t holds = 0;
+#ifdef WITE_LOCK_PROFILE
+    lockSite* site = NULL;
+    uint64_t heldSince;//from the outermost hold, guarded by mutex
+#endif
   public:
     advancedSyncLock();
+#ifdef WITE_LOCK_PROFILE
+    advancedSyncLock(const char* siteName) : site(lockSite::get(siteName)) {};
+#else
+    advancedSyncLock(const char*) {};//site name, for WITE_LOCK_PROFILE
+#endif
     ~advancedSyncLock();
     bool acquire(uint64_t timeoutNS = ~0);//0 means now or never. Execution maytake much longer than specified timeout.
     void release();
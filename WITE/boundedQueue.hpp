@@ -0,0 +1,181 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace WITE {
+
+  //fixed capacity lock-free FIFO queues. push returns false when full and pop returns false when empty; neither ever blocks or allocates.
+  //pick the weakest one that fits: spsc is a plain ring with no read-modify-writes, mpsc adds a CAS for producers only, mpmc for both sides.
+  //capacity must be a power of two. Items are assigned into and moved out of slots that live as long as the queue, so T must be default constructible.
+
+  //one producer thread, one consumer thread (Lamport ring). Each side keeps a private copy of the other side's index and only re-reads it (and pulls in that cache line) when the copy says full or empty.
+  template<class T, size_t CAPACITY> class spscQueue {
+  private:
+    static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "capacity must be a power of two");
+    static constexpr uint64_t mask = CAPACITY - 1;
+    alignas(64) std::atomic_uint64_t head = 0;//next to read, written by the consumer
+    uint64_t tailCache = 0;//consumer only
+    alignas(64) std::atomic_uint64_t tail = 0;//next to write, written by the producer
+    uint64_t headCache = 0;//producer only
+    alignas(64) std::unique_ptr<T[]> items;
+
+  public:
+    spscQueue() : items(std::make_unique<T[]>(CAPACITY)) {};
+    spscQueue(const spscQueue&) = delete;
+
+    template<class U> bool push(U&& t) {
+      const uint64_t pos = tail.load(std::memory_order_relaxed);
+      if(pos - headCache == CAPACITY) [[unlikely]] {
+	headCache = head.load(std::memory_order_acquire);//so the consumer's move out of the slot is done before we overwrite it
+	if(pos - headCache == CAPACITY)
+	  return false;
+      }
+      items[pos & mask] = std::forward<U>(t);
+      tail.store(pos + 1, std::memory_order_release);//publishes the item
+      return true;
+    };
+
+    //consumer only. Valid until the next pop.
+    T* peek() {
+      const uint64_t pos = head.load(std::memory_order_relaxed);
+      if(pos == tailCache) [[unlikely]] {
+	tailCache = tail.load(std::memory_order_acquire);
+	if(pos == tailCache)
+	  return NULL;
+      }
+      return &items[pos & mask];
+    };
+
+    bool pop(T& out) {
+      T* t = peek();
+      if(!t) return false;
+      out = std::move(*t);
+      head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);//hands the slot back to the producer
+      return true;
+    };
+
+    //only a snapshot unless called from one of the two threads while the other is idle
+    inline uint64_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); };
+    inline bool empty() const { return size() == 0; };
+    static constexpr uint64_t capacity() { return CAPACITY; };
+  };
+
+  //any number of producers (Vyukov). Each cell has a sequence number that says whether it is ready to be written or read on a given lap, so producers only contend on the tail and never wait on each other's writes.
+  template<class T, size_t CAPACITY> class boundedCellQueue_t {
+  protected:
+    static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "capacity must be a power of two");
+    static constexpr uint64_t mask = CAPACITY - 1;
+    struct cell_t {
+      std::atomic_uint64_t sequence;//== pos: free for the write of pos. == pos + 1: holds the item of pos.
+      T item;
+    };
+    alignas(64) std::atomic_uint64_t head = 0;//next to read
+    alignas(64) std::atomic_uint64_t tail = 0;//next to write
+    alignas(64) std::unique_ptr<cell_t[]> cells;
+
+    boundedCellQueue_t() : cells(std::make_unique<cell_t[]>(CAPACITY)) {
+      for(uint64_t i = 0;i < CAPACITY;i++)
+	cells[i].sequence.store(i, std::memory_order_relaxed);
+    };
+
+  public:
+    boundedCellQueue_t(const boundedCellQueue_t&) = delete;
+
+    template<class U> bool push(U&& t) {
+      uint64_t pos = tail.load(std::memory_order_relaxed);
+      while(true) {
+	cell_t& c = cells[pos & mask];
+	const int64_t diff = int64_t(c.sequence.load(std::memory_order_acquire) - pos);
+	if(diff == 0) {
+	  if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) [[likely]] {
+	    c.item = std::forward<U>(t);
+	    c.sequence.store(pos + 1, std::memory_order_release);
+	    return true;
+	  }
+	} else if(diff < 0) {//still holds an item from the previous lap
+	  return false;
+	} else {//another producer took pos
+	  pos = tail.load(std::memory_order_relaxed);
+	}
+      }
+    };
+
+    inline uint64_t size() const {
+      const uint64_t h = head.load(std::memory_order_acquire), t = tail.load(std::memory_order_acquire);
+      return t > h ? t - h : 0;
+    };
+    inline bool empty() const { return size() == 0; };
+    static constexpr uint64_t capacity() { return CAPACITY; };
+  };
+
+  //any number of producers, one consumer thread. The consumer owns the head outright, so pop is a load and two stores.
+  //an item whose producer has claimed its cell but not yet finished writing it holds back everything behind it, so pop can report empty while later items are ready.
+  template<class T, size_t CAPACITY> class mpscQueue : public boundedCellQueue_t<T, CAPACITY> {
+  private:
+    typedef boundedCellQueue_t<T, CAPACITY> base;
+
+  public:
+    //consumer only. Valid until the next pop.
+    T* peek() {
+      const uint64_t pos = this->head.load(std::memory_order_relaxed);
+      typename base::cell_t& c = this->cells[pos & base::mask];
+      if(c.sequence.load(std::memory_order_acquire) != pos + 1)
+	return NULL;
+      return &c.item;
+    };
+
+    bool pop(T& out) {
+      const uint64_t pos = this->head.load(std::memory_order_relaxed);
+      typename base::cell_t& c = this->cells[pos & base::mask];
+      if(c.sequence.load(std::memory_order_acquire) != pos + 1)
+	return false;
+      out = std::move(c.item);
+      this->head.store(pos + 1, std::memory_order_relaxed);
+      c.sequence.store(pos + CAPACITY, std::memory_order_release);//free for the write one lap later
+      return true;
+    };
+  };
+
+  //any number of producers and consumers. Consumers claim a cell with a CAS on the head, the mirror image of push.
+  template<class T, size_t CAPACITY> class mpmcQueue : public boundedCellQueue_t<T, CAPACITY> {
+  private:
+    typedef boundedCellQueue_t<T, CAPACITY> base;
+
+  public:
+    bool pop(T& out) {
+      uint64_t pos = this->head.load(std::memory_order_relaxed);
+      while(true) {
+	typename base::cell_t& c = this->cells[pos & base::mask];
+	const int64_t diff = int64_t(c.sequence.load(std::memory_order_acquire) - (pos + 1));
+	if(diff == 0) {
+	  if(this->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) [[likely]] {
+	    out = std::move(c.item);
+	    c.sequence.store(pos + CAPACITY, std::memory_order_release);
+	    return true;
+	  }
+	} else if(diff < 0) {//not written yet: empty
+	  return false;
+	} else {//another consumer took pos
+	  pos = this->head.load(std::memory_order_relaxed);
+	}
+      }
+    };
+  };
+
+}
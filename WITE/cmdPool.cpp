@@ -28,7 +28,11 @@ namespace WITE {
       scopeLock lock(pool->qMutex);
       VK_ASSERT(pool->q.submit2(1, &submit, fence), "failed to submit command buffer");
     }
-    pool->submitted.push(*this);
+    if(!pool->submitted.push(*this)) [[unlikely]] {
+      scopeLock lock(&pool->overflowMutex);
+      pool->overflow.push_back(*this);
+      pool->overflowCount.fetch_add(1, std::memory_order_release);
+    }
   };
 
   bool tempCmd::isPending() {
@@ -41,8 +45,19 @@ namespace WITE {
 
   cmdPool::cmdPool(vk::CommandPool pool, vk::Device dev, vk::Queue q, syncLock* qMutex) : pool(pool), dev(dev), q(q), qMutex(qMutex) {};
 
+  //buffers are freed with the vulkan pool, but each fence must be destroyed, after whatever it guards is done. Buffers that were allocated but never submitted are freed too, but their fences leak.
   cmdPool::~cmdPool() {
-    //TODO cleanup
+    auto release = [this](tempCmd& c) {
+      if(c.isPending())
+	c.waitFor();
+      dev.destroyFence(c.fence, ALLOCCB);
+    };
+    tempCmd c;
+    while(submitted.pop(c))
+      release(c);
+    for(tempCmd& o : overflow)
+      release(o);
+    dev.destroyCommandPool(pool, ALLOCCB);
   };
 
   cmdPool* cmdPool::forDevice(size_t idx) {//static
@@ -61,17 +76,29 @@ namespace WITE {
     return new cmdPool(pool, dev->getVkDevice(), dev->getLowPrioQueue(), dev->getLowPrioQueueMutex());
   };
 
+  bool cmdPool::reuseOverflow(tempCmd& out) {
+    if(!overflowCount.load(std::memory_order_acquire)) [[likely]]
+      return false;
+    scopeLock lock(&overflowMutex);
+    if(overflow.empty() || overflow.front().isPending())
+      return false;
+    out = overflow.front();
+    overflow.pop_front();
+    overflowCount.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  };
+
   tempCmd cmdPool::allocate() {
     tempCmd ret;
-    if(submitted.empty() || submitted.front().isPending()) {
+    tempCmd* oldest = submitted.peek();
+    if(oldest && !oldest->isPending()) {
+      submitted.pop(ret);
+    } else if(!reuseOverflow(ret)) {
       ret.pool = this;
       static constexpr vk::FenceCreateInfo fenceCI(vk::FenceCreateFlagBits::eSignaled);
       VK_ASSERT(dev.createFence(&fenceCI, ALLOCCB, &ret.fence), "failed to create fence");
       vk::CommandBufferAllocateInfo allocInfo(pool, vk::CommandBufferLevel::ePrimary, 1);
       VK_ASSERT(dev.allocateCommandBuffers(&allocInfo, &ret.cmd), "failed to allocate command buffer");
-    } else {
-      ret = submitted.front();
-      submitted.pop();
     }
     static constexpr vk::CommandBufferBeginInfo begin { vk::CommandBufferUsageFlagBits::eOneTimeSubmit };
     VK_ASSERT(ret->begin(&begin), "failed to begin cmd");
@@ -14,10 +14,13 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #pragma once
 
-#include <queue>
+#include <deque>
+#include <atomic>
 
 #include "wite_vulkan.hpp"
 #include "syncLock.hpp"
+#include "boundedQueue.hpp"
+#include "task.hpp"
 
 namespace WITE {
 
@@ -32,12 +35,17 @@ namespace WITE {
     void submit();
     bool isPending();
     void waitFor();
+    //co_await from a task (see task.hpp): continues once the fence is signaled, without holding a worker meanwhile. Counts as the one waitFor for this submit.
+    inline auto signaled() { return taskBase::blocking([c = *this]() mutable { c.waitFor(); }); };
     inline vk::CommandBuffer* operator->() { return &cmd; };
   };
 
   struct cmdPool {
     std::vector<tempCmd> all;
-    std::queue<tempCmd> submitted;
+    mpscQueue<tempCmd, 256> submitted;//oldest first, for reuse by allocate. Multi-producer so a stray submit from another thread (such as where a task resumed) can't corrupt it.
+    std::deque<tempCmd> overflow;//submitted while submitted was full, also oldest first
+    syncLock overflowMutex { "cmdPool::overflowMutex" };
+    std::atomic_uint32_t overflowCount = 0;//so allocate only takes the lock when there's something in overflow
     vk::CommandPool pool;
     vk::Device dev;
     vk::Queue q;
@@ -52,6 +60,8 @@ namespace WITE {
 
     tempCmd allocate();
     void waitFor();
+  private:
+    bool reuseOverflow(tempCmd& out);
 
   };
 
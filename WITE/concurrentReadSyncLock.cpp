@@ -18,59 +18,71 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 namespace WITE {
 
   void concurrentReadSyncLock::acquireRead() {
-    {
-      scopeLock lock(&internalMutex);
-      readLocks++;//do this early to prevent a new write from grabbing hold if a new one appears while we wait
-      if(!writeLocked) [[likely]] return;
-    }
-    uint32_t sleepCnt = 0;
-    while(true) {
-      thread::sleepShort(sleepCnt);
-      // scopeLock lock(&internalMutex);//we've already claimed a read, so as soon as the write is clear, we're good to start, no need to ask permission to read the write flag
-      if(!writeLocked) [[unlikely]] break;
-    }
+    const uint32_t w = readersIn.fetch_add(readerInc) & writerBits;
+#ifdef WITE_LOCK_PROFILE
+    const uint64_t waitStart = site && w ? lockSite::now() : 0;
+#endif
+    if(w) [[unlikely]]
+      //a writer holds the lock or is waiting for the readers before us. Wait for its phase to end rather than for no writer at all, so a stream of writers can't starve us.
+      thread::waitFor(readersIn, [this, w]() { return (readersIn.load(std::memory_order_acquire) & writerBits) != w; });
+#ifdef WITE_LOCK_PROFILE
+    if(site) lockSite::acquired(site->shared, waitStart, w);
+#endif
   };
 
   void concurrentReadSyncLock::releaseRead() {
-    scopeLock lock(&internalMutex);
-    readLocks--;
+    readersOut.fetch_add(readerInc);
+    if(readersIn.load() & writerPresent) [[unlikely]]//a writer might be waiting for us to leave. Both sides are seq_cst, so it either sees our exit or we see it.
+      readersOut.notify_all();
   };
 
   void concurrentReadSyncLock::acquireWrite() {
-    uint32_t sleepCnt = 0;
-    while(true) {
-      {
-	scopeLock lock(&internalMutex);
-	if(!writeLocked && readLocks == 0) [[likely]] {
-	  //not actually likely, but I optimize for the branch not headed for a wait
-	  writeLocked = true;
-	  break;
-	}
-      }
-      thread::sleepShort(sleepCnt);
-    }
+    const uint32_t ticket = writersIn.fetch_add(1, std::memory_order_relaxed);
+#ifdef WITE_LOCK_PROFILE
+    //contended if another writer is ahead of us or any reader is in. Checked before the wait, as the wait changes both.
+    const bool contended = site && (writersOut.load() != ticket || (readersIn.load() & ~writerBits) != readersOut.load());
+    const uint64_t waitStart = contended ? lockSite::now() : 0;
+#endif
+    thread::waitFor(writersOut, [this, ticket]() { return writersOut.load(std::memory_order_acquire) == ticket; });
+    //turn new readers away, then wait for the ones already in to leave
+    const uint32_t readers = readersIn.fetch_add(writerPresent | (ticket & writerPhase)) & ~writerBits;
+    thread::waitFor(readersOut, [this, readers]() { return readersOut.load() == readers; });
+#ifdef WITE_LOCK_PROFILE
+    if(site) writeHeldSince = lockSite::acquired(site->exclusive, waitStart, contended);
+#endif
   };
 
   void concurrentReadSyncLock::releaseWrite() {
-    scopeLock lock(&internalMutex);
-    writeLocked = false;
+#ifdef WITE_LOCK_PROFILE
+    if(site) lockSite::released(site->exclusive, writeHeldSince);
+#endif
+    readersIn.fetch_and(~writerBits, std::memory_order_release);
+    readersIn.notify_all();
+    writersOut.fetch_add(1, std::memory_order_release);
+    writersOut.notify_all();
   };
 
   bool concurrentReadSyncLock::isReadHeld() {
-    //no mutex bc the answer is outdated instantly anyway, unless the mutex is already held externally
-    return readLocks > 0 && !writeLocked;
+    //outdated instantly anyway, unless held externally
+    const uint32_t in = readersIn.load(std::memory_order_relaxed);
+    return !(in & writerPresent) && (in & ~writerBits) != readersOut.load(std::memory_order_relaxed);
   };
 
   bool concurrentReadSyncLock::isWriteHeld() {
-    //no mutex bc the answer is outdated instantly anyway, unless the mutex is already held externally
-    return writeLocked;
+    return readersIn.load(std::memory_order_relaxed) & writerPresent;
   };
 
   concurrentReadLock_read::concurrentReadLock_read(concurrentReadSyncLock* l) : lock(l) {
     l->acquireRead();
+#ifdef WITE_LOCK_PROFILE
+    if(l->site) heldSince = lockSite::now();
+#endif
   };
 
   concurrentReadLock_read::~concurrentReadLock_read() {
+#ifdef WITE_LOCK_PROFILE
+    if(lock->site) lockSite::released(lock->site->shared, heldSince);
+#endif
     lock->releaseRead();
   };
 
@@ -14,18 +14,34 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #pragma once
 
-#include "syncLock.hpp"
+#include <atomic>
+#include <cstdint>
+
+#include "lockProfile.hpp"
 
 namespace WITE {
 
   //allows one write hold with no reads, or many read holds with no write
+  //phase-fair ticket lock (Brandenburg and Anderson): readers never wait on each other, only on a writer that was already there when they arrived, and a writer waits for at most one phase of readers. Writers go in ticket order.
+  //not reentrant: a thread holding a read must not ask for another, as a writer may have arrived in between
   class concurrentReadSyncLock {
   private:
-    syncLock internalMutex;
-    bool writeLocked = false;
-    uint64_t readLocks = 0;
+    static constexpr uint32_t readerInc = 0x100, writerBits = 0x3, writerPresent = 0x2, writerPhase = 0x1;
+    alignas(64) std::atomic_uint32_t readersIn = 0;//readers arrived, in units of readerInc, plus a writer's present and phase bits
+    alignas(64) std::atomic_uint32_t readersOut = 0;//readers left, in units of readerInc
+    alignas(64) std::atomic_uint32_t writersIn = 0, writersOut = 0;//tickets
+#ifdef WITE_LOCK_PROFILE
+    lockSite* site = NULL;
+    uint64_t writeHeldSince;//only touched by the writer
+    friend class concurrentReadLock_read;//read hold times are kept by the guard, as there can be many
+#endif
   public:
     concurrentReadSyncLock() = default;
+#ifdef WITE_LOCK_PROFILE
+    concurrentReadSyncLock(const char* siteName) : site(lockSite::get(siteName)) {};
+#else
+    concurrentReadSyncLock(const char*) {};//site name, for WITE_LOCK_PROFILE
+#endif
     concurrentReadSyncLock(const concurrentReadSyncLock&) = delete;
     concurrentReadSyncLock(concurrentReadSyncLock&&) = delete;
     ~concurrentReadSyncLock() = default;
@@ -34,12 +50,15 @@ namespace WITE {
     void acquireWrite();
     void releaseWrite();
     bool isReadHeld();
-    bool isWriteHeld();
+    bool isWriteHeld();//or about to be, once the readers already in have left
   };
 
   class concurrentReadLock_read {
   private:
     concurrentReadSyncLock* lock;
+#ifdef WITE_LOCK_PROFILE
+    uint64_t heldSince;
+#endif
   public:
     concurrentReadLock_read() = delete;
     concurrentReadLock_read(const concurrentReadLock_read&) = delete;
@@ -14,8 +14,16 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #pragma once
 
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
 #include "dbUtils.hpp"
 #include "dbTableTuple.hpp"
+#include "dbBlobStore.hpp"
+#include "configuration.hpp"
+#include "task.hpp"
 
 namespace WITE {
 
@@ -30,47 +38,234 @@ optional members:
     void spunDown(uint64_t objectId, void* db) //called when the object is destroyed or when the game is closing (should clean up transients)
     size_t dbAllocationBatchSize
     size_t dbLogAllocationBatchSize
+    size_t dbShardCount //split the type's files into this many shards, ids interleaved across them (default 1)
     std::tuple<...> getIndexValues(uint64_t objectId, const T& data, void* db) //return type determines index types and order
+    uint32_t updatePhase //updates run in phases, all of one phase finish before any of the next start
+    typedef std::tuple<...> updateAfter //types whose updates must finish before this one's start (puts this type in a later phase)
+    int32_t updatePriority //within a phase, higher priority types are started first
    */
 
   //each type is stored as-is on disk (memcpy and mmap) so should be simple. POD except for static members is recommended.
   template<class... TYPES> class database {
-  private:
+  public:
     static constexpr size_t tableCount = sizeof...(TYPES);
     static_assert(tableCount > 0);
+
+    //see getFrameStats. Times are wall time in nanoseconds on the thread calling updateTick and endFrame unless noted.
+    struct frameStats {
+      uint64_t frame,
+	updateDispatchNs,//updateTick, including waiting between update phases
+	updateWaitNs,//endFrame waiting for the last update phase to finish
+	logWaitNs,//endFrame waiting for background log application started by the previous frame (pipelined, or a table being backed up)
+	indexNs,//applying batched index changes
+	commitNs,//commitFrame and timed wakeups
+	changeFeedNs,//publishing the frame to the change feed, if there is one
+	logApplyNs,//applying logs, or in pipelined mode submitting them
+	pipelinedLogNs,//time background jobs spent applying the logs submitted by the previous frame
+	frameNs;//from the end of the previous endFrame to the end of this one
+      bool backupInProgress;
+      std::array<dbTableFrameStats, tableCount> tables;//in the order the types were given to the database
+    };
+
+  private:
     std::atomic_uint64_t currentFrame;
     dbTableTuple<TYPES...> bobby;//327
-    threadPool threads;//dedicated thread pool so we can tell when all frame data is done
-    std::atomic_bool backupInProgress;
-    std::string backupTarget;
-    thread* backupThread = NULL;
+    dbBlobStore blobs;//variable-length data referenced from records, shared by all types
+    //pipelined mode (configuration option dbpipelined=1): log application for old frames runs in the background lane while the next frame updates, counted by logsApplied (declared first so it outlives the pool)
+    //otherwise logs are applied in endFrame, except for a table with a backup due, which is handed to the background lane the same way (see applyLogsThrough)
+    bool pipelined;
+    threadPool::counter_t logsApplied;
+    threadPool threads;//dedicated thread pool so we can tell when all frame data is done. Frame work is in the frame-critical lane.
+    //backups: requestBackup sets backupRequested, the next endFrame snapshots which rows to include (beginBackup), and log application writes each table's file just before it passes that frame
+    std::atomic_bool backupInProgress, backupRequested;
+    std::filesystem::path backupTarget;
+    bool backupFull = false;
+    uint64_t lastBackupFrame = NONE;//an increment needs a previous backup from this session to be relative to
     std::atomic_uint64_t tablesBackedUp;
+    std::atomic_bool blobsBackedUp;
+    //tasks suspended until a frame is committed (see frameCommitted), resumed by the next updateTick after it is
+    std::vector<std::pair<uint64_t, std::coroutine_handle<>>> frameWaiters;
+    syncLock frameWaitersMutex { "database::frameWaitersMutex" };
+    //see enableChangeFeed. NULL if not enabled.
+    std::unique_ptr<dbChangeFeed> changeFeed;
+    //telemetry: pendingStats is filled in over the course of a frame and published to lastStats by endFrame
+    frameStats pendingStats {}, lastStats {};
+    std::array<dbTableFrameStats, tableCount> lastCounters {};
+    std::atomic_uint64_t pipelinedLogNs;
+    uint64_t lastFrameEndNs;
+    syncLock statsMutex { "database::statsMutex" };//only guards lastStats
+    //optional rolling csv (configuration option dbstatscsv=<path>), rotated to <path>.1 every dbstatscsvrows rows
+    std::ofstream statsCsv;
+    std::filesystem::path statsCsvPath;
+    uint64_t statsCsvRows = 0, statsCsvMaxRows = 0;
+
+    static inline uint64_t nowNs() {
+      return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()).time_since_epoch().count();
+    };
+
+    //returns the time since t and resets t to now
+    static inline uint64_t lap(uint64_t& t) {
+      uint64_t now = nowNs(), ret = now - t;
+      t = now;
+      return ret;
+    };
 
-    template<class T, class... REST> inline void applyLogsThrough(uint64_t applyFrame) {
-      bobby.template get<T::typeId>().applyLogsAll(applyFrame);
+    template<class A, class... REST> inline void gatherTableStats(std::array<dbTableFrameStats, tableCount>& out, size_t i = 0) {
+      out[i] = bobby.template get<A::typeId>().getCounters();
       if constexpr(sizeof...(REST) > 0)
-	applyLogsThrough<REST...>(applyFrame);
+	gatherTableStats<REST...>(out, i + 1);
     };
 
-    template<class T, class... REST> inline void backupTable(uint64_t applyFrame) {
-      //log files won't be backed up, and won't be applied while the backup is running, so just get all the mdfs to a common frame and let all new data flow sit around in the logs
+    template<class A, class... REST> inline void writeStatsCsvHeader() {
+      const std::string& name = bobby.template get<A::typeId>().getFileId();
+      for(const char* col : { "updates", "logsWritten", "logsApplied", "allocations", "frees" })
+	statsCsv << "," << name << "_" << col;
+      if constexpr(sizeof...(REST) > 0)
+	writeStatsCsvHeader<REST...>();
+      else
+	statsCsv << "\n";
+    };
+
+    void openStatsCsv() {
+      statsCsv.open(statsCsvPath, std::ios::out | std::ios::trunc);
+      ASSERT_TRAP(statsCsv, "could not open stats csv ", statsCsvPath);
+      statsCsv << "frame,updateDispatchNs,updateWaitNs,logWaitNs,indexNs,commitNs,changeFeedNs,logApplyNs,pipelinedLogNs,frameNs,backupInProgress";
+      writeStatsCsvHeader<TYPES...>();
+      statsCsvRows = 0;
+    };
+
+    void writeStatsCsvRow(const frameStats& fs) {
+      if(statsCsvRows >= statsCsvMaxRows) [[unlikely]] {
+	statsCsv.close();
+	std::error_code ec;
+	std::filesystem::path old = statsCsvPath;
+	old += ".1";
+	std::filesystem::rename(statsCsvPath, old, ec);
+	openStatsCsv();
+      }
+      statsCsv << fs.frame << "," << fs.updateDispatchNs << "," << fs.updateWaitNs << "," << fs.logWaitNs << "," << fs.indexNs << "," << fs.commitNs << "," << fs.changeFeedNs << ","
+	       << fs.logApplyNs << "," << fs.pipelinedLogNs << "," << fs.frameNs << "," << fs.backupInProgress;
+      for(const dbTableFrameStats& t : fs.tables)
+	statsCsv << "," << t.updates << "," << t.logsWritten << "," << t.logsApplied << "," << t.allocations << "," << t.frees;
+      statsCsv << "\n";
+      statsCsvRows++;
+    };
+
+    //called by endFrame after all of its work, before the frame number advances
+    void publishFrameStats() {
+      std::array<dbTableFrameStats, tableCount> counters;
+      gatherTableStats<TYPES...>(counters);
+      pendingStats.frame = currentFrame;
+      for(size_t i = 0;i < tableCount;i++)
+	pendingStats.tables[i] = {
+	  .updates = counters[i].updates - lastCounters[i].updates,
+	  .logsWritten = counters[i].logsWritten - lastCounters[i].logsWritten,
+	  .logsApplied = counters[i].logsApplied - lastCounters[i].logsApplied,
+	  .allocations = counters[i].allocations - lastCounters[i].allocations,
+	  .frees = counters[i].frees - lastCounters[i].frees,
+	};
+      lastCounters = counters;
+      pendingStats.backupInProgress = backupInProgress.load(std::memory_order_relaxed);
+      pendingStats.frameNs = lap(lastFrameEndNs);
+      {
+	scopeLock l(&statsMutex);
+	lastStats = pendingStats;
+      }
+      if(statsCsv.is_open())
+	writeStatsCsvRow(pendingStats);
+      pendingStats = {};
+    };
+
+    //a pending backup must be written before the logs it depends on are applied
+    template<class T> inline void applyTableLogs(uint64_t applyFrame, bool pipelined) {
       auto& tbl = bobby.template get<T::typeId>();
-      tbl.applyLogsAll(applyFrame);
-      tbl.copyMdf(backupTarget);
-      tablesBackedUp.fetch_add(1, std::memory_order_relaxed);
+      if(tbl.backupDue(applyFrame)) [[unlikely]] {
+	//the blobs are copied before the first table's file is written, so a backup with every table present has its blobs
+	if(!blobsBackedUp.exchange(true, std::memory_order_acq_rel))
+	  blobs.writeBackup(backupTarget, lastBackupFrame);
+	tbl.writeBackup();
+	if(tablesBackedUp.fetch_add(1, std::memory_order_acq_rel) + 1 == tableCount)
+	  backupInProgress.store(false, std::memory_order_release);
+      }
+      if constexpr(dbShardCountOf<T>::value > 1) {
+	if(!pipelined) {
+	  //shards are independent, so apply them in parallel. Pipelined, the tables are already applied in parallel with each other, under the background cap.
+	  threads.parallelFor(0, dbShardCountOf<T>::value, [&tbl, applyFrame](uint64_t b, uint64_t e) {
+	    for(uint64_t i = b;i < e;i++)
+	      tbl.applyLogsShard(i, applyFrame, false);
+	  }, 1, threadPool::lane_e::eFrameCritical);
+	  return;
+	}
+      }
+      tbl.applyLogsAll(applyFrame, pipelined);
+    };
+
+    //backupInBackground: a table with a backup due is applied by a background job instead, as in pipelined mode, so copying it out stays off the frame's critical path. That job writes the backup before it applies the logs, and the next endFrame waits for it before touching the table's logs again.
+    template<class T, class... REST> inline void applyLogsThrough(uint64_t applyFrame, bool backupInBackground) {
+      if(backupInBackground && bobby.template get<T::typeId>().backupDue(applyFrame)) [[unlikely]]
+	dbJobWrapper<T, &database::applyLogsPipelined<T>>(applyFrame, this, threads, &logsApplied, threadPool::lane_e::eBackground);
+      else
+	applyTableLogs<T>(applyFrame, false);
+      if constexpr(sizeof...(REST) > 0)
+	applyLogsThrough<REST...>(applyFrame, backupInBackground);
+    };
+
+    template<class T> static void applyLogsPipelined(uint64_t applyFrame, void* dbv) {
+      database* db = reinterpret_cast<database*>(dbv);
+      uint64_t start = nowNs();
+      db->template applyTableLogs<T>(applyFrame, true);
+      db->pipelinedLogNs.fetch_add(lap(start), std::memory_order_relaxed);
+    };
+
+    //one job per table, tables are independent
+    template<class T, class... REST> inline void submitLogsThrough(uint64_t applyFrame) {
+      dbJobWrapper<T, &database::applyLogsPipelined<T>>(applyFrame, this, threads, &logsApplied, threadPool::lane_e::eBackground);
+      if constexpr(sizeof...(REST) > 0)
+	submitLogsThrough<REST...>(applyFrame);
+    };
+
+    template<class T, class... REST> inline void publishChanges(uint64_t frame) {
+      bobby.template get<T::typeId>().publishChanges(frame, *changeFeed);
+      if constexpr(sizeof...(REST) > 0)
+	publishChanges<REST...>(frame);
+    };
+
+    template<class T, class... REST> inline void setTrackChanges(bool track) {
+      bobby.template get<T::typeId>().setTrackChanges(track);
+      if constexpr(sizeof...(REST) > 0)
+	setTrackChanges<REST...>(track);
+    };
+
+    template<class T, class... REST> inline void releaseQuarantine() {
+      bobby.template get<T::typeId>().releaseQuarantine();
+      if constexpr(sizeof...(REST) > 0)
+	releaseQuarantine<REST...>();
+    };
+
+    template<class T, class... REST> inline void beginBackup(uint64_t frame, uint64_t previousFrame) {
+      bobby.template get<T::typeId>().beginBackup(backupTarget, frame, previousFrame);
       if constexpr(sizeof...(REST) > 0)
-	backupTable<REST...>(applyFrame);
+	beginBackup<REST...>(frame, previousFrame);
     };
 
-    void backupThreadEntry() {
-      uint64_t applyFrame = maxFrame() - 1;
-      uint32_t sleepCnt = 0;
-      while(minFrame() >= applyFrame) {//need more log variety to ensure only a complete frame is written
-	thread::sleepShort(sleepCnt);
-	applyFrame = maxFrame() - 1;
+    //frame must be complete, with nothing running
+    void beginBackup(uint64_t frame) {
+      tablesBackedUp.store(0, std::memory_order_relaxed);
+      blobsBackedUp.store(false, std::memory_order_relaxed);
+      beginBackup<TYPES...>(frame, backupFull || lastBackupFrame == NONE ? NONE : lastBackupFrame);
+      lastBackupFrame = frame;
+    };
+
+    template<class T, class... REST> static inline uint64_t restoreBackup(const std::filesystem::path& backupDir, const std::filesystem::path& basedir, uint64_t throughFrame) {
+      uint64_t ret = dbTable<T>::restore(backupDir, basedir, T::dbFileId, throughFrame);
+      if constexpr(sizeof...(REST) > 0) {
+	uint64_t other = restoreBackup<REST...>(backupDir, basedir, throughFrame);
+	if(ret != other) [[unlikely]] {
+	  WARN("backup tables restored to different frames: ", ret, " and ", other);
+	  ret = NONE;
+	}
       }
-      backupTable<TYPES...>(applyFrame);
-      backupInProgress.store(false, std::memory_order_release);
+      return ret;
     };
 
     template<class A, class... REST> inline uint64_t maxFrame() {
@@ -87,37 +282,111 @@ optional members:
       return ret;
     };
 
-    template<class A, class... REST> inline void updateAll() {
+    //the object whose update is running on this thread, so that writes to itself do not wake it
+    static thread_local uint64_t updatingTypeId, updatingOid;
+
+    template<class A, void(*F)(uint64_t, void*)> static void forEachLiveRange(uint64_t begin, uint64_t end, void* db) {
+      reinterpret_cast<database*>(db)->bobby.template get<A::typeId>().template forEachLive<false>(begin, end, [db](uint64_t oid) { F(oid, db); });
+    };
+
+    template<class A> static void updateRange(uint64_t begin, uint64_t end, void* db) {
+      auto& tbl = reinterpret_cast<database*>(db)->bobby.template get<A::typeId>();
+      const auto start = std::chrono::steady_clock::now();
+      uint64_t updates = 0;
+      tbl.template forEachLive<true>(begin, end, [db, &updates](uint64_t oid) {
+	updatingTypeId = A::typeId;
+	updatingOid = oid;
+	A::update(oid, db);
+	updatingOid = NONE;
+	updates++;
+      });
+      tbl.countUpdates(updates);
+      tbl.timeUpdateRange(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    };
+
+    //one job per range of objects rather than per object, so dispatch cost scales with thread count instead of object count
+    //several chunks per thread so that threads that draw cheap objects can pick up more work. Updates pass a count tuned per table from the last frame (see dbChunkTuning), spin ups and downs are rare enough to keep the default
+    template<class A, void(*F)(uint64_t, uint64_t, void*)> inline void submitForEachLive(uint64_t chunksPerThread = 8) {
+      const uint64_t words = bobby.template get<A::typeId>().liveWords(),
+	chunk = (words - 1) / (threads.getThreadCount() * chunksPerThread) + 1;//round up
+      for(uint64_t i = 0;i < words;i += chunk)
+	dbRangeJobWrapper<F>(i, min(i + chunk, words), this, threads);
+    };
+
+    typedef void(database::*updateSubmitter_t)();
+    struct updateSchedule_t {
+      uint32_t phase;
+      int32_t priority;
+      size_t declarationOrder;
+      updateSubmitter_t submit;
+    };
+    static constexpr size_t updatedTypeCount = (size_t(has_update<TYPES>::value) + ...);
+
+    template<class A> inline void submitUpdates() {
+      submitForEachLive<A, &database::updateRange<A>>(bobby.template get<A::typeId>().updateChunksPerThread());
+    };
+
+    template<class A> static constexpr void addToUpdateSchedule(std::array<updateSchedule_t, updatedTypeCount>& schedule, size_t& i) {
       if constexpr(has_update<A>::value) {
-	auto& tbl = bobby.template get<A::typeId>();
-	auto iter = tbl.begin();
-	auto end = tbl.end();
-	while(iter != end) {
-	  uint64_t oid = *(iter++);
-	  //NOTE: postfix operator, iterator MUST be incremented before update is called or else the iterator might be invalidadted if the object deletes itself in its own update (which is the recommended place to delete something).
-	  dbJobWrapper<A, A::update>(oid, this, threads);
-	}
+	schedule[i] = { dbUpdatePhaseOf<A>::value, dbUpdatePriorityOf<A>::value, i, &database::submitUpdates<A> };
+	i++;
+      }
+    };
+
+    static constexpr std::array<updateSchedule_t, updatedTypeCount> makeUpdateSchedule() {
+      std::array<updateSchedule_t, updatedTypeCount> ret {};
+      size_t i = 0;
+      (addToUpdateSchedule<TYPES>(ret, i), ...);
+      std::sort(ret.begin(), ret.end(), [](const updateSchedule_t& l, const updateSchedule_t& r) {
+	if(l.phase != r.phase) return l.phase < r.phase;
+	if(l.priority != r.priority) return l.priority > r.priority;
+	return l.declarationOrder < r.declarationOrder;
+      });
+      return ret;
+    };
+
+    //starts (as frame-critical jobs) the tasks waiting on frames that are now committed
+    void resumeFrameWaiters() {
+      scopeLock l(&frameWaitersMutex);
+      const uint64_t committed = currentFrame.load(std::memory_order_relaxed);
+      std::erase_if(frameWaiters, [this, committed](const auto& w) {
+	if(w.first >= committed) return false;
+	taskBase::resume(&threads, w.second, threadPool::lane_e::eFrameCritical);
+	return true;
+      });
+    };
+
+    void updateAll() {
+      static constexpr std::array<updateSchedule_t, updatedTypeCount> schedule = makeUpdateSchedule();
+      for(size_t i = 0;i < updatedTypeCount;i++) {
+	if(i && schedule[i].phase != schedule[i-1].phase) [[unlikely]]
+	  threads.waitForLane(threadPool::lane_e::eFrameCritical);//barrier only where phases are declared, everything else interleaves
+	(this->*schedule[i].submit)();
       }
-      if constexpr(sizeof...(REST) > 0)
-	updateAll<REST...>();
     };
 
     template<class A, class... REST> inline void spinUpAll() {
       if constexpr(has_spunUp<A>::value)
-	for(uint64_t oid : bobby.template get<A::typeId>())
-	  dbJobWrapper<A, A::spunUp>(oid, this, threads);
+	submitForEachLive<A, &database::forEachLiveRange<A, A::spunUp>>();
       if constexpr(sizeof...(REST) > 0)
 	spinUpAll<REST...>();
     };
 
     template<class A, class... REST> inline void spinDownAll() {
       if constexpr(has_spunDown<A>::value)
-	for(uint64_t oid : bobby.template get<A::typeId>())
-	  dbJobWrapper<A, A::spunDown>(oid, this, threads);
+	submitForEachLive<A, &database::forEachLiveRange<A, A::spunDown>>();
       if constexpr(sizeof...(REST) > 0)
 	spinDownAll<REST...>();
     };
 
+    template<class A, class... REST> inline void commitFrame() {
+      auto& tbl = bobby.template get<A::typeId>();
+      tbl.commitFrame();
+      tbl.wakeThrough(currentFrame + 1);
+      if constexpr(sizeof...(REST) > 0)
+	commitFrame<REST...>();
+    };
+
     template<uint64_t O, class A, class I, class... REST>
     inline bool checkAllIndices_L2(uint64_t expectedSize, dbIndexTuple<O, A, I, REST...>& idx) {
       //check by count only (for now)
@@ -136,53 +405,126 @@ optional members:
 	clearAllIndices<O+1, A, REST...>(idx.next());
     };
 
-    template<uint64_t O, class A, class I, class... REST>
-    inline void rebalanceAllIndices(dbIndexTuple<O, A, I, REST...>& idx) {
-      idx->rebalance();
+    //computes the index values as of the committed frame and as of the current frame for the queued ids in [begin, end)
+    template<class A> static void buildIndexChanges(uint64_t begin, uint64_t end, void* dbv) {
+      database* db = reinterpret_cast<database*>(dbv);
+      auto& idx = db->bobby.template getIndices<A::typeId>();
+      for(uint64_t i = begin;i < end;i++) {
+	auto& c = idx.batch[i];
+	A data;
+	c.oid = idx.batchIds[i];
+	c.hasNew = db->read(c.oid, 0, &data);
+	if(c.hasNew) [[likely]] {
+	  c.newValues = A::getIndexValues(c.oid, data, dbv);
+	  c.hasOld = db->read(c.oid, 1, &data);//false if created this frame
+	  if(c.hasOld) [[likely]]
+	    c.oldValues = A::getIndexValues(c.oid, data, dbv);
+	} else {
+	  c.hasOld = false;//destroyed this frame, pendingRemovals holds the values to remove
+	}
+      }
+    };
+
+    //each index is independent, so each gets its own job
+    template<class A, size_t O> static void applyIndexChanges(uint64_t, void* dbv) {
+      database* db = reinterpret_cast<database*>(dbv);
+      auto& idx = db->bobby.template getIndices<A::typeId>();
+      auto& dbi = idx->template get<O>();
+      for(const auto& c : idx.batch) {
+	if(c.hasOld && c.hasNew && std::get<O>(c.oldValues) == std::get<O>(c.newValues)) [[likely]]
+	  continue;
+	if(c.hasOld)
+	  dbi.remove(std::get<O>(c.oldValues), c.oid);
+	if(c.hasNew)
+	  dbi.insert(c.oid, std::get<O>(c.newValues));
+      }
+      dbi.checkHealth();
+    };
+
+    //each index of A is applied as soon as A's changes are built, without waiting on other tables
+    template<class A, size_t O = 0> inline void continueIndexChanges(threadPool::counter_t& built, threadPool::counter_t& applied) {
+      const threadPool::job_t j = dbJobWrapper<A, &database::applyIndexChanges<A, O>>::job(0, this);
+      threads.then(built, &j, &applied);
+      if constexpr(O + 1 < dbIndexTupleFor<A>::count)
+	continueIndexChanges<A, O+1>(built, applied);
+    };
+
+    template<class A, class... REST> inline void gatherIndexChanges(threadPool::counter_t& applied) {
+      if constexpr(dbIndexTupleFor<A>::exists) {
+	auto& idx = bobby.template getIndices<A::typeId>();
+	idx.batchIds.clear();
+	idx.batch.clear();
+	for(auto& ids : idx.pendingWrites) {
+	  concat(idx.batchIds, ids);
+	  ids.clear();
+	}
+	std::sort(idx.batchIds.begin(), idx.batchIds.end());
+	idx.batchIds.erase(std::unique(idx.batchIds.begin(), idx.batchIds.end()), idx.batchIds.end());
+	const uint64_t writes = idx.batchIds.size();
+	idx.batch.resize(writes);
+	for(auto& removals : idx.pendingRemovals) {
+	  concat(idx.batch, removals);
+	  removals.clear();
+	}
+	//batch must not be resized after this point until the jobs are done
+	const uint64_t chunk = max(writes / threads.getThreadCount() + 1, 256);
+	for(uint64_t i = 0;i < writes;i += chunk)
+	  dbRangeJobWrapper<&database::buildIndexChanges<A>>(i, min(i + chunk, writes), this, threads, &idx.built);
+	if(idx.batch.size())
+	  continueIndexChanges<A>(idx.built, applied);
+      }
       if constexpr(sizeof...(REST) > 0)
-	clearAllIndices<O+1, A, REST...>(idx.next());
+	gatherIndexChanges<REST...>(applied);
     };
 
-    template<uint64_t O, class A, class... IT>
-    inline void insertToAllIndices(uint64_t eid,
-				   const std::tuple<IT...>& tpl,
-				   dbIndexTuple<0, A, IT...>& idx)
-    {
-      idx.template get<O>().insert(eid, std::get<O>(tpl));
-      if constexpr(O + 1 < sizeof...(IT))
-	this->template insertToAllIndices<O+1, A, IT...>(eid, tpl, idx);
+    template<class A, class... REST> inline void waitIndexChangesBuilt() {
+      if constexpr(dbIndexTupleFor<A>::exists)
+	threads.wait(bobby.template getIndices<A::typeId>().built);
+      if constexpr(sizeof...(REST) > 0)
+	waitIndexChangesBuilt<REST...>();
+    };
+
+    //must be called while no updates are running, and before logs from the prior frame are applied
+    void applyIndexChanges() {
+      threadPool::counter_t applied;
+      gatherIndexChanges<TYPES...>(applied);
+      threads.wait(applied);
+      waitIndexChangesBuilt<TYPES...>();//done by now, but their finishing threads might still hold them
+    };
+
+    //each index is independent, so each is rebuilt by its own job
+    template<class A, size_t O> static void rebuildIndex(uint64_t, void* dbv) {
+      database* db = reinterpret_cast<database*>(dbv);
+      auto& dbi = db->bobby.template getIndices<A::typeId>()->template get<O>();
+      uint64_t i = 0;
+      for(uint64_t eid : db->bobby.template get<A::typeId>()) {
+	A data;
+	if(!db->read(eid, 0, &data))
+	  continue;//pending delete
+	//getIndexValues exists on type because the index exists
+	dbi.insert(eid, std::get<O>(A::getIndexValues(eid, data, dbv)));
+	if((++i) % 128 == 0)
+	  dbi.rebalance();
+      }
     };
 
-    template<uint64_t O, class A, class... IT>
-    inline void removeFromAllIndices(uint64_t eid,
-				     const std::tuple<IT...>& tpl,
-				     dbIndexTuple<0, A, IT...>& idx)
-    {
-      idx.template get<O>().remove(std::get<O>(tpl), eid);
-      if constexpr(O + 1 < sizeof...(IT))
-	removeFromAllIndices<O+1, A, IT...>(eid, tpl, idx);
+    template<class A, size_t O = 0> inline void submitIndexRebuilds(threadPool::counter_t& rebuilt) {
+      dbJobWrapper<A, &database::rebuildIndex<A, O>>(0, this, threads, &rebuilt, threadPool::lane_e::eNormal);
+      if constexpr(O + 1 < dbIndexTupleFor<A>::count)
+	submitIndexRebuilds<A, O+1>(rebuilt);
     };
 
-    template<class A, class... REST> inline void checkAllIndices() {
+    template<class A, class... REST> inline void checkAllIndices(threadPool::counter_t& rebuilt) {
       auto& idx = bobby.template getIndices<A::typeId>();
       if constexpr(std::remove_reference_t<decltype(idx)>::exists) {
-	if(!checkAllIndices_L2<0, A>(bobby.template get<A::typeId>().size(), *idx)) {
+	if(!checkAllIndices_L2<0, A>(bobby.template get<A::typeId>().liveCount(), *idx)) {
 	  //if one is broken, all might be, so rebuild them all
 	  clearAllIndices<0, A>(*idx);
-	  uint64_t i = 0;
-	  for(uint64_t eid : bobby.template get<A::typeId>()) {
-	    A data;
-	    read(eid, 0, &data);
-	    //getIndexValues exists on type because idx::exists
-	    auto tpl = A::getIndexValues(eid, data, reinterpret_cast<void*>(this));
-	    insertToAllIndices<0, A>(eid, tpl, *idx);
-	    if((++i) % 128 == 0)
-	      rebalanceAllIndices<0, A>(*idx);
-	  }
+	  submitIndexRebuilds<A>(rebuilt);
 	}
       }
       if constexpr(sizeof...(REST) > 0)
-	checkAllIndices<REST...>();
+	checkAllIndices<REST...>(rebuilt);
     };
 
     template<class A, class... REST> inline void deleteFiles() {
@@ -198,10 +540,24 @@ optional members:
     };
 
   public:
-    database(const std::filesystem::path& basedir, bool clobberMaster, bool clobberLog) : bobby(basedir, clobberMaster, clobberLog) {
+    database(const std::filesystem::path& basedir, bool clobberMaster, bool clobberLog) : bobby(basedir, clobberMaster, clobberLog), blobs(basedir, clobberMaster) {
       ASSERT_TRAP(clobberLog || !clobberMaster, "cannot keep log without master");
+      pipelined = configuration::getOptionBool("dbpipelined");
+      if(const char* csv = configuration::getOption("dbstatscsv")) {
+	statsCsvPath = csv;
+	statsCsvMaxRows = configuration::getOption("dbstatscsvrows", 1000000ull);
+	openStatsCsv();
+      }
+      if(const char* feed = configuration::getOption("dbchangefeed"))
+	enableChangeFeed()->streamTo(openFile(feed, true, false));
+      lastFrameEndNs = nowNs();
       currentFrame = maxFrame() + 1;
-      checkAllIndices<TYPES...>();
+      blobs.recover(currentFrame - 1);
+      {
+	threadPool::counter_t rebuilt;
+	checkAllIndices<TYPES...>(rebuilt);
+	threads.wait(rebuilt);
+      }
       spinUpAll<TYPES...>();
     };
 
@@ -217,49 +573,98 @@ optional members:
 
     //process a single frame, part 1: updates only
     void updateTick() {
-      threads.waitForAll();
-      updateAll<TYPES...>();
+      threads.waitForLane(threadPool::lane_e::eFrameCritical);
+      uint64_t t = nowNs();
+      resumeFrameWaiters();
+      updateAll();
+      pendingStats.updateDispatchNs = lap(t);
     };
 
-    //process a single frame, part 2: logfile maintenance
+    //process a single frame, part 2: index and logfile maintenance
+    //in pipelined mode, log application is only started here, and runs concurrently with the next frame's updates. It is always finished before the next endFrame starts its own maintenance.
     void endFrame() {
-      threads.waitForAll();
-      if(!backupInProgress.load(std::memory_order_consume)) { //don't flush logs when the mdfs are being copied
-	if(backupThread) {
-	  //all threads should be joined once they're finished
-	  backupThread->join();//should be immediately joinable since it's done (or very nearly so)
-	  backupThread = NULL;
-	}
-	if(currentFrame > MIN_LOG_HISTORY)
-	  applyLogsThrough<TYPES...>(currentFrame - MIN_LOG_HISTORY);
+      uint64_t t = nowNs();
+      threads.waitForLane(threadPool::lane_e::eFrameCritical);
+      pendingStats.updateWaitNs = lap(t);
+      //pipelined, the previous frame's log application. Otherwise only tables that were backed up in the background, if any.
+      threads.wait(logsApplied);
+      pendingStats.logWaitNs = lap(t);
+      pendingStats.pipelinedLogNs = pipelinedLogNs.exchange(0, std::memory_order_relaxed);
+      applyIndexChanges();
+      pendingStats.indexNs = lap(t);
+      commitFrame<TYPES...>();
+      pendingStats.commitNs = lap(t);
+      if(changeFeed) {
+	//the frame is complete and its logs are all still present, so each changed row's state as of this frame is one load away
+	changeFeed->beginFrame();
+	publishChanges<TYPES...>(currentFrame);
+	changeFeed->endFrame(currentFrame);
+	pendingStats.changeFeedNs = lap(t);
       }
+      if(backupRequested.exchange(false, std::memory_order_acquire)) [[unlikely]]
+	beginBackup(currentFrame);
+      //nothing that was running concurrently with the last log application is still running, so nothing can hold a quarantined id
+      releaseQuarantine<TYPES...>();
+      //a blob freed in frame f is reclaimed on the same schedule as a row destroyed in frame f (pipelined, which is one frame later)
+      if(currentFrame > MIN_LOG_HISTORY + 1)
+	blobs.releaseThrough(currentFrame - MIN_LOG_HISTORY - 1);
+      if(currentFrame > MIN_LOG_HISTORY) {
+	if(pipelined)
+	  submitLogsThrough<TYPES...>(currentFrame - MIN_LOG_HISTORY);
+	else
+	  applyLogsThrough<TYPES...>(currentFrame - MIN_LOG_HISTORY, true);
+      }
+      pendingStats.logApplyNs = lap(t);
+      publishFrameStats();
       currentFrame.fetch_add(1, std::memory_order_relaxed);
     };
 
-    bool requestBackup(const std::string& outdir) {
+    //starts publishing every frame's creates, writes and destroys to a change feed, beginning with the next frame to end. Call between frames. Returns the feed, for the caller to consume or stream. Calling again returns the same feed.
+    //ringBytes defaults to the configuration option dbchangefeedbytes, or 64MB. Frames that don't fit because the consumer has fallen behind are dropped, the frame loop never waits on the consumer.
+    //with the configuration option dbchangefeed=<path>, the database enables this itself and streams it into that file (or fifo).
+    dbChangeFeed* enableChangeFeed(uint64_t ringBytes = configuration::getOption("dbchangefeedbytes", uint64_t(1) << 26)) {
+      if(!changeFeed) {
+	changeFeed = std::make_unique<dbChangeFeed>(ringBytes);
+	setTrackChanges<TYPES...>(true);
+      }
+      return changeFeed.get();
+    };
+
+    //backs up the state as of the end of the current frame (or, if called between frames, the next frame) into outdir, as one file per table named for the frame
+    //full: every object. Otherwise an increment containing only the objects created, written or destroyed since the previous backup. The first backup after opening the database is always full.
+    //nothing is copied until log application reaches that frame, and then only the rows in the backup are read, so neither updates nor log application are held up. Returns false if a backup is already in progress.
+    bool requestBackup(const std::string& outdir, bool full = true) {
       bool t = false;
       std::error_code ec;
       if(!std::filesystem::exists(outdir))
 	ASSERT_TRAP_OR_RUN(std::filesystem::create_directories(outdir, ec), "create dir failed ", ec);
       ASSERT_TRAP(std::filesystem::is_directory(outdir, ec), "not a directory ", ec);
       if(backupInProgress.compare_exchange_strong(t, true, std::memory_order_acq_rel)) {
-	tablesBackedUp.store(0, std::memory_order_relaxed);
 	backupTarget = outdir;
-	if(backupThread) {
-	  //all threads should be joined once they're finished
-	  backupThread->join();//should be immediately joinable since it's done (or very nearly so)
-	  backupThread = NULL;
-	}
-	//callback allocation is forgivable for file io
-	backupThread = thread::spawnThread(thread::threadEntry_t_F::make(this, &database::backupThreadEntry));
+	backupFull = full;
+	backupRequested.store(true, std::memory_order_release);
 	return true;
       } else {
 	return false;
       }
     };
 
+    inline bool isBackupInProgress() {
+      return backupInProgress.load(std::memory_order_acquire);
+    };
+
+    //rebuilds the database files in basedir from the newest full backup in backupDir at or before throughFrame, followed by each increment after it
+    //the database must not be open in basedir, open it afterward with clobberMaster = false and clobberLog = true. Returns the frame restored to, or NONE on failure.
+    static uint64_t restoreBackup(const std::filesystem::path& backupDir, const std::filesystem::path& basedir, uint64_t throughFrame = NONE) {
+      uint64_t ret = restoreBackup<TYPES...>(backupDir, basedir, throughFrame);
+      if(ret != NONE) [[likely]]
+	dbBlobStore::restore(backupDir, basedir, ret);
+      return ret;
+    };
+
     void deleteFiles() {
       deleteFiles<TYPES...>();
+      blobs.deleteFiles();
     }
 
     void deleteLogs() {
@@ -269,20 +674,41 @@ optional members:
     void gracefulShutdown() {
       ASSERT_TRAP(currentFrame > 0, "cannot shutdown a db on frame 0");
       threads.waitForAll();
-      uint32_t sleepCnt = 0;
-      while(backupInProgress.load(std::memory_order_consume)) thread::sleepShort(sleepCnt);
-      applyLogsThrough<TYPES...>(currentFrame - 1);
+      {
+	scopeLock l(&frameWaitersMutex);
+	if(!frameWaiters.empty()) [[unlikely]]
+	  WARN(frameWaiters.size(), " tasks are still waiting on future frames, and will never be resumed");
+      }
+      threads.wait(logsApplied);//already done, but the thread that finished it might still hold it
+      releaseQuarantine<TYPES...>();
+      applyIndexChanges();
+      commitFrame<TYPES...>();
+      if(backupRequested.exchange(false, std::memory_order_acquire))
+	beginBackup(currentFrame - 1);
+      applyLogsThrough<TYPES...>(currentFrame - 1, false);//also writes any pending backup
+      blobs.releaseThrough(currentFrame - 1);
       spinDownAll<TYPES...>();
       threads.waitForAll();
       deleteLogs();
+      if(changeFeed)
+	changeFeed->close();
+    };
+
+    //a snapshot of the counters and phase timings of the most recently finished frame. Safe to call from any thread.
+    frameStats getFrameStats() {
+      scopeLock l(&statsMutex);
+      return lastStats;
+    };
+
+    //cumulative totals since the database was opened
+    template<class A> inline dbTableFrameStats getTableCounters() {
+      return bobby.template get<A::typeId>().getCounters();
     };
 
     template<class A> uint64_t create(A* data) {
       uint64_t ret = bobby.template get<A::typeId>().allocate(currentFrame, data);
-      if constexpr(dbIndexTupleFor<A>::exists) {
-	auto tpl = A::getIndexValues(ret, *data, reinterpret_cast<void*>(this));
-	insertToAllIndices<0, A>(ret, tpl, *bobby.template getIndices<A::typeId>());
-      }
+      if constexpr(dbIndexTupleFor<A>::exists)
+	bobby.template getIndices<A::typeId>().pendingWrites.get()->push_back(ret);
       if constexpr(has_allocated<A>::value)
 	A::allocated(ret, this);
       if constexpr(has_spunUp<A>::value)
@@ -298,9 +724,10 @@ optional members:
     template<class A> void destroy(uint64_t oid) {
       if constexpr(dbIndexTupleFor<A>::exists) {
 	A data;
-	read(oid, 0, &data);
-	auto tpl = A::getIndexValues(oid, data, reinterpret_cast<void*>(this));
-	removeFromAllIndices<0, A>(oid, tpl, *bobby.template getIndices<A::typeId>());
+	if(readCommitted(oid, &data)) [[likely]] {//else created this frame, so it's not in the index yet
+	  auto& idx = bobby.template getIndices<A::typeId>();
+	  idx.pendingRemovals.get()->push_back({ oid, true, false, A::getIndexValues(oid, data, reinterpret_cast<void*>(this)) });
+	}
       }
       if constexpr(has_spunDown<A>::value)
 	A::spunDown(oid, this);
@@ -329,20 +756,57 @@ optional members:
     };
 
     //does NOT lock the row, externally lock if more than one write might happen in a frame.
+    //wakes the object if it is asleep, unless it is the object currently updating on this thread
     template<class A> inline void write(uint64_t oid, A* in) {
-      if constexpr(dbIndexTupleFor<A>::exists) {
-	auto newTpl = A::getIndexValues(oid, *in, reinterpret_cast<void*>(this));
-	A oldData;
-	read(oid, 0, &oldData);
-	auto oldTpl = A::getIndexValues(oid, oldData, reinterpret_cast<void*>(this));
-	if(newTpl != oldTpl) [[unlikely]] {
-	  //likeliness unknown, but when this does happen, the impact of unlikely is comparatively trivial
-	  auto& idx = *bobby.template getIndices<A::typeId>();
-	  removeFromAllIndices<0, A>(oid, oldTpl, idx);
-	  insertToAllIndices<0, A>(oid, newTpl, idx);
-	}
-      }
-      return bobby.template get<A::typeId>().store(oid, currentFrame, in);
+      if constexpr(dbIndexTupleFor<A>::exists)
+	bobby.template getIndices<A::typeId>().pendingWrites.get()->push_back(oid);
+      auto& tbl = bobby.template get<A::typeId>();
+      if(oid != updatingOid || A::typeId != updatingTypeId) [[likely]]
+	tbl.wake(oid);
+      return tbl.store(oid, currentFrame, in);
+    };
+
+    //the object's update will not be called until it is woken by wake, by a write from anything other than its own update, or (if untilFrame is not NONE) at the start of frame untilFrame
+    //intended for objects that have nothing to do until something happens to them. Sleep state is not persisted.
+    template<class A> inline void sleep(uint64_t oid, uint64_t untilFrame = NONE) {
+      bobby.template get<A::typeId>().sleep(oid, untilFrame);
+    };
+
+    template<class A> inline void wake(uint64_t oid) {
+      bobby.template get<A::typeId>().wake(oid);
+    };
+
+    //variable-length data: store the returned handle in a record. Blobs are immutable, so to change one write a new blob and free the old one in the same frame the record is written.
+    inline dbBlobHandle writeBlob(const void* data, uint64_t size) {
+      return blobs.write(data, size, currentFrame);
+    };
+
+    template<class T> inline dbBlobHandle writeBlob(std::span<const T> data) {
+      return blobs.write(data.data(), data.size_bytes(), currentFrame);
+    };
+
+    //for filling in a blob in place. The handle must not be stored anywhere until the contents are written.
+    inline dbBlobHandle allocateBlob(uint64_t size, std::span<uint8_t>* out) {
+      return blobs.allocate(size, currentFrame, out);
+    };
+
+    //zero-copy. Valid as long as a frame that references the handle can still be read (same as any frameDelay passed to read)
+    inline std::span<const uint8_t> readBlob(dbBlobHandle h) {
+      return blobs.read(h);
+    };
+
+    template<class T> inline std::span<const T> readBlobAs(dbBlobHandle h) {
+      std::span<const uint8_t> raw = blobs.read(h);
+      return { reinterpret_cast<const T*>(raw.data()), raw.size() / sizeof(T) };
+    };
+
+    //the blob is not referenced as of this frame. Does nothing if h is NONE.
+    inline void freeBlob(dbBlobHandle h) {
+      blobs.free(h, currentFrame);
+    };
+
+    inline uint64_t blobCount() {
+      return blobs.size();
     };
 
     //returns a lock object representing the single object to ensure sequential io to that object
@@ -354,6 +818,39 @@ optional members:
       return currentFrame;
     };
 
+    //tasks (see task.hpp) that touch the database: spawned here they run on the database's pool, by default in the frame-critical lane so endFrame waits for them.
+    //a task may only touch the database during the update phase: right after being spawned (from an update or before updateTick), or right after awaiting nextFrame or frameCommitted, all of which resume it in the update phase.
+    //other awaits (io, fences, counters) resume whenever they're done, possibly during endFrame, so await nextFrame after them before touching the database again.
+    template<class T> void spawn(task<T>&& t, threadPool::counter_t* counter = NULL, threadPool::lane_e lane = threadPool::lane_e::eFrameCritical) {
+      std::move(t).spawn(threads, counter, lane);
+    };
+
+    //co_await from a task: continues in the update phase of the first frame after frame has been committed, on the database's pool in the frame-critical lane. Doesn't suspend if it already has been.
+    struct frameAwaiter_t {
+      database* db;
+      uint64_t frame;
+      bool await_ready() { return frame < db->currentFrame.load(std::memory_order_acquire); };
+      bool await_suspend(std::coroutine_handle<> h) {
+	scopeLock l(&db->frameWaitersMutex);
+	if(frame < db->currentFrame.load(std::memory_order_acquire)) [[unlikely]]
+	  return false;//committed since await_ready
+	db->frameWaiters.emplace_back(frame, h);
+	return true;
+      };
+      void await_resume() {};
+    };
+
+    frameAwaiter_t frameCommitted(uint64_t frame) {
+      return { this, frame };
+    };
+
+    //the update phase of the next frame
+    frameAwaiter_t nextFrame() {
+      return { this, currentFrame.load(std::memory_order_acquire) };
+    };
+
+    //index queries reflect the committed frame: index changes caused by create, write and destroy are applied in a batch by endFrame, so they are first visible in the following frame. Query with values from readCommitted for consistent results.
+
     template<class A, size_t idxId> inline uint64_t findByIdx(const auto& value) {
       static_assert(dbIndexTupleFor<A>::exists, "can't findByIdx when there is no idx");
       return bobby.template getIndices<A::typeId>()->template get<idxId>().findAny(value);
@@ -369,6 +866,49 @@ optional members:
       bobby.template getIndices<A::typeId>()->template get<idxId>().forEach(l, h, cb);
     };
 
+    //cursors for ordered iteration and pagination, see dbIndex::cursor
+    template<class A, size_t idxId> inline auto seekByIdx(const auto& value) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't seek when there is no idx");
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().seek(value);
+    };
+
+    template<class A, size_t idxId> inline auto seekBackByIdx(const auto& value) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't seek when there is no idx");
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().seekBack(value);
+    };
+
+    template<class A, size_t idxId> inline bool nextByIdx(auto& cursor) {
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().next(cursor);
+    };
+
+    template<class A, size_t idxId> inline bool prevByIdx(auto& cursor) {
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().prev(cursor);
+    };
+
+    template<class A, size_t idxId, bool forward = true, class L> inline uint64_t pageByIdx(auto& cursor, const auto& bound, uint64_t limit, L cb) {
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().template page<forward>(cursor, bound, limit, cb);
+    };
+
+    //see dbIndex::stats
+    template<class A, size_t idxId> inline auto getIndexStats() {
+      static_assert(dbIndexTupleFor<A>::exists, "can't get stats when there is no idx");
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().getStats();
+    };
+
+    //cheap selectivity estimate from the index histogram, for choosing between query strategies
+    template<class A, size_t idxId> inline uint64_t estimateCountByIdx(const auto& l, const auto& h) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't estimate when there is no idx");
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().estimateCount(l, h);
+    };
+
+    template<class A, size_t idxId> inline uint64_t countByIdx(const auto& l, const auto& h) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't count when there is no idx");
+      return bobby.template getIndices<A::typeId>()->template get<idxId>().count(l, h);
+    };
+
   };
 
+  template<class... TYPES> thread_local uint64_t database<TYPES...>::updatingTypeId = NONE;
+  template<class... TYPES> thread_local uint64_t database<TYPES...>::updatingOid = NONE;
+
 };
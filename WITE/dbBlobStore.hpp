@@ -0,0 +1,279 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <map>
+#include <span>
+#include <tuple>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <vector>
+
+#include "dbFile.hpp"
+#include "syncLock.hpp"
+#include "stdExtensions.hpp"
+
+namespace WITE {
+
+  typedef uint64_t dbBlobHandle;//NONE for no blob
+
+  //variable-length data kept beside the fixed-size tables and referenced from records by handle, for things like names and inventories that would otherwise need child rows or oversized arrays.
+  //blobs are immutable: to change one, write a new blob, store its handle in the record, and free the old one. A freed blob is only reclaimed once no frame that can still be read might reference it, so a reader of an older frame sees the blob its version of the record points to, the same as with logs.
+  //storage is one dbFile per power-of-two size class, each created on first use
+  //backups (see writeBackup) copy every file, so a backup always has the blobs its records point to
+  class dbBlobStore {
+  public:
+    struct readOnly_t {};
+    static constexpr readOnly_t readOnlyTag {};
+    static constexpr size_t headerSize = 3 * sizeof(uint64_t),
+      minSlotBits = 6,
+      classCount = 15;//64B to 1MB slots, including the header
+    static constexpr uint64_t maxSize = (uint64_t(1) << (minSlotBits + classCount - 1)) - headerSize;
+
+  private:
+    static constexpr size_t classShift = 58;
+    static constexpr uint64_t localMask = (uint64_t(1) << classShift) - 1;
+
+    template<size_t C> struct slot_t {
+      uint64_t size, allocatedFrame, freedFrame;//freedFrame is NONE while the blob is live
+      uint8_t data[(size_t(1) << (minSlotBits + C)) - headerSize];
+    };
+    static_assert(sizeof(slot_t<0>) == size_t(1) << minSlotBits);
+
+    template<size_t C> using file_t = dbFile<slot_t<C>, max(size_t(65536) >> (minSlotBits + C), size_t(1))>;
+
+    template<size_t... C> static std::tuple<std::atomic<file_t<C>*>...> filesFor(std::index_sequence<C...>);
+
+    const std::filesystem::path basedir;
+    const bool readOnly = false;
+    decltype(filesFor(std::make_index_sequence<classCount>())) files;//NULL until first used
+    syncLock filesMutex { "dbBlobStore::filesMutex" };//only for creating files
+    std::multimap<uint64_t, dbBlobHandle> pendingFrees;//frame -> handle
+    syncLock pendingMutex { "dbBlobStore::pendingMutex" };
+
+    static inline size_t classOf(uint64_t size) {
+      return max(size_t(std::bit_width(size + headerSize - 1)), minSlotBits) - minSlotBits;
+    };
+
+    //calls f with the class as an integral_constant, so it can reach the file of the right type
+    template<size_t C = 0, class F> static inline auto withClass(size_t c, F&& f) {
+      if constexpr(C + 1 < classCount) {
+	if(c != C)
+	  return withClass<C + 1>(c, std::forward<F>(f));
+      }
+      ASSERT_TRAP(c == C, "invalid blob class ", c);
+      return f(std::integral_constant<size_t, C>());
+    };
+
+    static inline std::filesystem::path filenameFor(const std::filesystem::path& dir, size_t c) {
+      return dir / concat({ "blob_", std::to_string(size_t(1) << (minSlotBits + c)), ".wdb" });
+    };
+
+    inline std::filesystem::path filenameFor(size_t c) {
+      return filenameFor(basedir, c);
+    };
+
+    static inline std::filesystem::path backupFilenameFor(const std::filesystem::path& dir, size_t c, uint64_t frame) {
+      return dir / concat({ "backup_blob_", std::to_string(size_t(1) << (minSlotBits + c)), "_", std::to_string(frame), ".wdb" });
+    };
+
+    template<size_t C> file_t<C>* fileFor(bool create) {
+      auto& a = std::get<C>(files);
+      file_t<C>* ret = a.load(std::memory_order_acquire);
+      if(ret || !create) [[likely]] return ret;
+      ASSERT_TRAP(!readOnly, "attempted to write to a read-only blob store");
+      scopeLock l(&filesMutex);
+      ret = a.load(std::memory_order_relaxed);
+      if(!ret) {
+	ret = new file_t<C>(filenameFor(C), false);
+	a.store(ret, std::memory_order_release);
+      }
+      return ret;
+    };
+
+    template<size_t C> inline slot_t<C>& slotFor(dbBlobHandle h) {
+      file_t<C>* f = fileFor<C>(false);
+      ASSERT_TRAP(f, "blob handle refers to a class with no file ", h);
+      return f->deref(h & localMask);
+    };
+
+  public:
+    //existing files are opened immediately (unless clobbered) so that recover can find their pending frees
+    dbBlobStore(const std::filesystem::path& basedir, bool clobber) : basedir(basedir) {
+      for(size_t c = 0;c < classCount;c++) {
+	const std::filesystem::path fn = filenameFor(c);
+	if(clobber)
+	  std::filesystem::remove(fn);
+	else if(std::filesystem::exists(fn))
+	  withClass(c, [this]<size_t C>(std::integral_constant<size_t, C>) { fileFor<C>(true); });
+      }
+    };
+
+    //for reading a copy of another store's files, such as a restored backup (see dbReplica). Nothing is written, and recover must not be called.
+    dbBlobStore(const std::filesystem::path& basedir, readOnly_t) : basedir(basedir), readOnly(true) {
+      for(size_t c = 0;c < classCount;c++) {
+	const std::filesystem::path fn = filenameFor(c);
+	if(std::filesystem::exists(fn))
+	  withClass(c, [this, &fn]<size_t C>(std::integral_constant<size_t, C>) {
+	    std::get<C>(files).store(new file_t<C>(fn, file_t<C>::readOnlyTag), std::memory_order_release);
+	  });
+      }
+    };
+
+    dbBlobStore(const dbBlobStore&) = delete;
+
+    ~dbBlobStore() {
+      close();
+    };
+
+    void close() {
+      for(size_t c = 0;c < classCount;c++)
+	withClass(c, [this]<size_t C>(std::integral_constant<size_t, C>) { delete std::get<C>(files).exchange(NULL); });
+    };
+
+    void deleteFiles() {
+      close();
+      for(size_t c = 0;c < classCount;c++)
+	std::filesystem::remove(filenameFor(c));
+    };
+
+    //reschedules frees that were pending when the store was last closed. Frees from frames after lastFrame did not survive (with the logs that referenced them) so they are cancelled instead, and blobs allocated after lastFrame can't be referenced by anything that survived, so they are reclaimed.
+    //call once, after opening, before any other use
+    void recover(uint64_t lastFrame) {
+      std::vector<uint64_t> lost;
+      for(size_t c = 0;c < classCount;c++) {
+	withClass(c, [this, lastFrame, &lost]<size_t C>(std::integral_constant<size_t, C>) {
+	  file_t<C>* f = fileFor<C>(false);
+	  if(!f) return;
+	  lost.clear();
+	  for(uint64_t id : *f) {
+	    slot_t<C>& s = f->deref(id);
+	    if(s.allocatedFrame > lastFrame) [[unlikely]]
+	      lost.push_back(id);
+	    else if(s.freedFrame == NONE) [[likely]]
+	      continue;
+	    else if(s.freedFrame > lastFrame)
+	      s.freedFrame = NONE;
+	    else
+	      pendingFrees.emplace(s.freedFrame, (uint64_t(C) << classShift) | id);
+	  }
+	  for(uint64_t id : lost)//not while iterating, free breaks the iterator
+	    f->free(id);
+	});
+      }
+    };
+
+    //copies every file into outdir, named for the frame. Each file is copied under a temporary name and renamed when complete.
+    //the files are copied whole, including blobs allocated or freed after frame, which recover sorts out when the copy is opened (see restore). So the copy must be taken before anything freed after frame can be reclaimed.
+    //allocation in each file waits for its copy, reads and frees do not
+    void writeBackup(const std::filesystem::path& outdir, uint64_t frame) {
+      for(size_t c = 0;c < classCount;c++) {
+	withClass(c, [this, &outdir, frame]<size_t C>(std::integral_constant<size_t, C>) {
+	  file_t<C>* f = fileFor<C>(false);
+	  if(!f) return;
+	  const std::filesystem::path fn = backupFilenameFor(outdir, C, frame);
+	  std::filesystem::path tempFilename = fn;
+	  tempFilename += ".tmp";
+	  f->copy(tempFilename);
+	  std::error_code ec;
+	  std::filesystem::rename(tempFilename, fn, ec);
+	  ASSERT_TRAP(!ec, "failed to rename backup file ", fn, ec);
+	});
+      }
+    };
+
+    //replaces the files in basedir with the copies written by writeBackup for the given frame. Open the store afterward with clobber = false, and recover through frame.
+    static void restore(const std::filesystem::path& backupDir, const std::filesystem::path& basedir, uint64_t frame) {
+      for(size_t c = 0;c < classCount;c++) {
+	const std::filesystem::path fn = filenameFor(basedir, c), backup = backupFilenameFor(backupDir, c, frame);
+	std::filesystem::remove(fn);
+	if(std::filesystem::exists(backup))
+	  std::filesystem::copy_file(backup, fn);
+      }
+    };
+
+    //allocates a blob of the given size and sets out to its contents, to be filled in before the handle is published anywhere
+    //frame is the frame the blob is allocated in, the first frame that can reference it
+    dbBlobHandle allocate(uint64_t size, uint64_t frame, std::span<uint8_t>* out) {
+      ASSERT_TRAP(size <= maxSize, "blob too big: ", size);
+      return withClass(classOf(size), [this, size, frame, out]<size_t C>(std::integral_constant<size_t, C>) {
+	file_t<C>* f = fileFor<C>(true);
+	const uint64_t id = f->allocate();
+	slot_t<C>& s = f->deref(id);
+	s.size = size;
+	s.allocatedFrame = frame;
+	s.freedFrame = NONE;
+	*out = { s.data, size };
+	return (uint64_t(C) << classShift) | id;
+      });
+    };
+
+    dbBlobHandle write(const void* data, uint64_t size, uint64_t frame) {
+      std::span<uint8_t> out;
+      dbBlobHandle ret = allocate(size, frame, &out);
+      std::memcpy(out.data(), data, size);
+      return ret;
+    };
+
+    //zero-copy: points into the mapped file, and stays valid until the blob is reclaimed
+    std::span<const uint8_t> read(dbBlobHandle h) {
+      if(h == NONE) [[unlikely]] return {};
+      return withClass(h >> classShift, [this, h]<size_t C>(std::integral_constant<size_t, C>) {
+	const slot_t<C>& s = slotFor<C>(h);
+	return std::span<const uint8_t>(s.data, s.size);
+      });
+    };
+
+    //the blob is no longer referenced as of the given frame. It is reclaimed by releaseThrough once that frame can no longer be read.
+    void free(dbBlobHandle h, uint64_t frame) {
+      if(h == NONE) [[unlikely]] return;
+      withClass(h >> classShift, [this, h, frame]<size_t C>(std::integral_constant<size_t, C>) {
+	slot_t<C>& s = slotFor<C>(h);
+	ASSERT_TRAP(s.freedFrame == NONE, "blob freed twice ", h);
+	s.freedFrame = frame;
+      });
+      scopeLock l(&pendingMutex);
+      pendingFrees.emplace(frame, h);
+    };
+
+    //number of blobs in storage, including freed ones that are not reclaimed yet
+    uint64_t size() {
+      uint64_t ret = 0;
+      for(size_t c = 0;c < classCount;c++) {
+	withClass(c, [this, &ret]<size_t C>(std::integral_constant<size_t, C>) {
+	  file_t<C>* f = fileFor<C>(false);
+	  if(f) ret += f->size();
+	});
+      }
+      return ret;
+    };
+
+    //reclaims every blob freed at or before the given frame
+    void releaseThrough(uint64_t frame) {
+      scopeLock l(&pendingMutex);
+      auto end = pendingFrees.upper_bound(frame);
+      for(auto it = pendingFrees.begin();it != end;it++) {
+	const dbBlobHandle h = it->second;
+	withClass(h >> classShift, [this, h]<size_t C>(std::integral_constant<size_t, C>) {
+	  fileFor<C>(false)->free(h & localMask);
+	});
+      }
+      pendingFrees.erase(pendingFrees.begin(), end);
+    };
+
+  };
+
+}
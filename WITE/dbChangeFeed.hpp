@@ -0,0 +1,249 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <span>
+#include <cstring>
+#include <bit>
+#include <algorithm>
+
+#include "thread.hpp"
+#include "mmap.hpp"
+#include "shared.hpp"
+#include "DEBUG.hpp"
+
+namespace WITE {
+
+  //a stream of everything that changed in each committed frame, for mirroring the database into other processes
+  //the database publishes whole frames into a ring buffer. If a frame doesn't fit, it is dropped, never waited on, and the next frame that does fit starts with an eGap record.
+  //the ring has a single consumer: either consume, called by the owner, or streamTo, which drains it into a file or pipe on its own thread.
+  //stream format (the same as the ring, minus padding): records of record_t followed by `size` bytes of payload, padded to 8 bytes. Each frame's records end with an eFrameEnd.
+  class dbChangeFeed {
+  public:
+    enum class op_e : uint32_t {
+      eCreate,//payload is the new object
+      eUpdate,//payload is the object as of the end of the frame
+      eDelete,//no payload
+      eFrameEnd,//no payload, id is the number of create, update and delete records in the frame
+      eGap,//no payload, frame is the first frame that was dropped. Everything from there up to this record's frame is missing, so the consumer must resync
+      ePad,//ring only, never given to consumers
+    };
+
+    struct record_t {
+      uint64_t typeId, id, frame;
+      op_e op;
+      uint32_t size;
+    };
+    static_assert(sizeof(record_t) == 32);
+
+    static constexpr uint64_t paddedSize(uint64_t payload) {
+      return sizeof(record_t) + ((payload + 7) & ~uint64_t(7));
+    };
+
+  private:
+    const uint64_t capacity, mask;
+    std::unique_ptr<uint64_t[]> ring;//uint64_t for alignment
+    //byte positions, only ever increase. The producer fills from head while writing a frame and publishes it by advancing head.
+    alignas(64) std::atomic_uint64_t head;
+    alignas(64) std::atomic_uint64_t tail;
+    //producer state, frame thread only
+    uint64_t staging = 0, frameRecords = 0, gapFrom = NONE;
+    bool overflowed = false;
+    std::atomic_uint64_t framesPublished, framesDropped;
+    //streaming
+    fileHandle streamFd;
+    thread* streamThread = NULL;
+    std::atomic_bool stopping, streamBroken;
+    std::atomic_uint32_t streamWake;//bumped on publish and close, the idle stream thread parks on it
+
+    inline uint8_t* at(uint64_t pos) {
+      return reinterpret_cast<uint8_t*>(ring.get()) + (pos & mask);
+    };
+
+    //returns the position to write a record of the given padded size, or NONE if there isn't room. Pads to the start of the ring if needed.
+    uint64_t reserve(uint64_t bytes) {
+      uint64_t pos = staging;
+      const uint64_t toEnd = capacity - (pos & mask);
+      uint64_t skip = 0;
+      if(toEnd < bytes) [[unlikely]]
+	skip = toEnd;
+      if(pos + skip + bytes - tail.load(std::memory_order_acquire) > capacity) [[unlikely]]
+	return NONE;
+      if(skip) {
+	if(skip >= sizeof(record_t)) {
+	  record_t* pad = reinterpret_cast<record_t*>(at(pos));
+	  pad->op = op_e::ePad;
+	  pad->size = static_cast<uint32_t>(skip - sizeof(record_t));
+	}//else the consumer wraps on its own, as there is no room for a record
+	pos += skip;
+      }
+      staging = pos + bytes;
+      return pos;
+    };
+
+    //calls f(pos, bytes) for each record in [from, to), including padding
+    template<class F> inline void walk(uint64_t from, uint64_t to, F f) {
+      while(from < to) {
+	const uint64_t toEnd = capacity - (from & mask);
+	if(toEnd < sizeof(record_t)) [[unlikely]] {
+	  from += toEnd;
+	  continue;
+	}
+	const record_t* r = reinterpret_cast<const record_t*>(at(from));
+	const uint64_t bytes = paddedSize(r->size);
+	f(from, *r);
+	from += bytes;
+      }
+    };
+
+    void streamEntry() {
+      thread::ignoreBrokenPipe();
+      while(true) {
+	const bool last = stopping.load(std::memory_order_acquire);
+	const uint64_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_acquire);
+	if(t == h) {
+	  if(last) break;
+	  thread::waitFor(streamWake, [this, t]() {
+	    return stopping.load(std::memory_order_acquire) || head.load(std::memory_order_acquire) != t;
+	  });
+	  continue;
+	}
+	//write runs of contiguous records at once, splitting only at padding
+	uint64_t runStart = t, runEnd = t;
+	auto flush = [&]() {
+	  if(runEnd > runStart && !streamBroken.load(std::memory_order_relaxed) &&
+	     !writeFile(streamFd, at(runStart), static_cast<uint32_t>(runEnd - runStart))) [[unlikely]] {
+	    WARN("change feed consumer stopped reading, dropping all further changes");
+	    streamBroken.store(true, std::memory_order_relaxed);
+	  }
+	};
+	walk(t, h, [&](uint64_t pos, const record_t& r) {
+	  if(pos != runEnd || r.op == op_e::ePad || pos - runStart > (1 << 24)) {
+	    flush();
+	    runStart = pos;
+	  }
+	  runEnd = pos + paddedSize(r.size);
+	  if(r.op == op_e::ePad)
+	    runStart = runEnd;
+	});
+	flush();
+	tail.store(h, std::memory_order_release);
+      }
+      closeFile(streamFd);
+    };
+
+  public:
+    //capacity is rounded up to a power of two. A frame larger than the ring is always dropped.
+    dbChangeFeed(uint64_t bytes) :
+      capacity(std::bit_ceil(std::max<uint64_t>(bytes, 4096))),
+      mask(capacity - 1),
+      ring(std::make_unique<uint64_t[]>(capacity / sizeof(uint64_t))) {};
+
+    dbChangeFeed(const dbChangeFeed&) = delete;
+
+    ~dbChangeFeed() {
+      close();
+    };
+
+    //flushes and stops streaming, if streaming
+    void close() {
+      if(!streamThread) return;
+      stopping.store(true, std::memory_order_release);
+      streamWake.fetch_add(1, std::memory_order_release);
+      streamWake.notify_one();
+      streamThread->join();
+      streamThread = NULL;
+    };
+
+    //starts a thread that writes everything published to fd (which can be a file, a pipe or a fifo), and closes it when this feed is closed. Must be called at most once, before anything else consumes.
+    //if the consumer falls behind, frames are dropped (with a gap record) rather than held. If it goes away, everything after is dropped.
+    void streamTo(fileHandle fd) {
+      ASSERT_TRAP(!streamThread, "change feed is already streaming");
+      streamFd = fd;
+      streamThread = thread::spawnThread(thread::threadEntry_t_F::make<dbChangeFeed>(this, &dbChangeFeed::streamEntry));
+    };
+
+    //calls f(const record_t&, std::span<const uint8_t> payload) for every record published since the last call, then frees their space. Returns the number of records. Not for use while streaming.
+    template<class F> uint64_t consume(F f) {
+      ASSERT_TRAP(!streamThread, "cannot consume a change feed that is streaming");
+      const uint64_t t = tail.load(std::memory_order_relaxed), h = head.load(std::memory_order_acquire);
+      uint64_t ret = 0;
+      walk(t, h, [&](uint64_t pos, const record_t& r) {
+	if(r.op == op_e::ePad) return;
+	f(r, std::span<const uint8_t>(at(pos) + sizeof(record_t), r.size));
+	ret++;
+      });
+      tail.store(h, std::memory_order_release);
+      return ret;
+    };
+
+    //producer interface, for the database. Frame thread only, between frames.
+    void beginFrame() {
+      staging = head.load(std::memory_order_relaxed);
+      frameRecords = 0;
+      overflowed = false;
+      if(gapFrom != NONE)
+	append(0, NONE, gapFrom, op_e::eGap, NULL, 0);
+      frameRecords = 0;
+    };
+
+    void append(uint64_t typeId, uint64_t id, uint64_t frame, op_e op, const void* payload, uint32_t size) {
+      if(overflowed) [[unlikely]] return;
+      const uint64_t pos = reserve(paddedSize(size));
+      if(pos == NONE) [[unlikely]] {
+	overflowed = true;
+	return;
+      }
+      record_t* r = reinterpret_cast<record_t*>(at(pos));
+      *r = { typeId, id, frame, op, size };
+      if(size)
+	std::memcpy(at(pos) + sizeof(record_t), payload, size);
+      frameRecords++;
+    };
+
+    void endFrame(uint64_t frame) {
+      append(0, frameRecords, frame, op_e::eFrameEnd, NULL, 0);
+      if(overflowed) [[unlikely]] {
+	if(gapFrom == NONE)
+	  gapFrom = frame;
+	framesDropped.fetch_add(1, std::memory_order_relaxed);
+	return;
+      }
+      gapFrom = NONE;
+      head.store(staging, std::memory_order_release);
+      framesPublished.fetch_add(1, std::memory_order_relaxed);
+      if(streamThread) {
+	streamWake.fetch_add(1, std::memory_order_release);
+	streamWake.notify_one();
+      }
+    };
+
+    inline uint64_t getFramesPublished() {
+      return framesPublished.load(std::memory_order_relaxed);
+    };
+
+    inline uint64_t getFramesDropped() {
+      return framesDropped.load(std::memory_order_relaxed);
+    };
+
+    inline bool isStreamBroken() {
+      return streamBroken.load(std::memory_order_relaxed);
+    };
+
+  };
+
+}
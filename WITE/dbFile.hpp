@@ -25,6 +25,7 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include "DEBUG.hpp"
 #include "shared.hpp"
 #include "mmap.hpp"
+#include "stableVector.hpp"
 
 namespace WITE {
 
@@ -47,15 +48,16 @@ namespace WITE {
     static constexpr size_t au_size = sizeof(au_t);
     static constexpr uint8_t plug[au_size] = { 0 };
 
-    syncLock fileMutex;
-    concurrentReadSyncLock blocksMutex, allocationMutex;
+    syncLock fileMutex { "dbFile::fileMutex" };
+    concurrentReadSyncLock blocksMutex { "dbFile::blocksMutex" }, allocationMutex { "dbFile::allocationMutex" };
     header_t* header;
-    std::vector<au_t*> blocks;//these are pointers into mmaped regions
+    stableVector<au_t*> blocks;//these are pointers into mmaped regions. Elements never move, so deref_unsafe is safe during growth
     struct mmap_t { void*region; size_t len; };
     std::vector<mmap_t> mmapedRegions;//for later gc, because elements of `blocks` might be trimmed due to alignment requirements
     fileHandle fd;
     const std::filesystem::path filename;
     size_t fileSize;
+    const bool readOnly = false;
 #if DEBUG
     std::set<uint64_t> freeSpaceBitmap;//sanity check for debugging only, duplicates the on-disk allocation queue
 #endif
@@ -84,10 +86,71 @@ namespace WITE {
       return blocks[idx / AU]->allocatedLL[idx % AU];
     };
 
+    //appends one allocation unit to the file
+    void grow_unsafe() {
+      ASSERT_TRAP(!readOnly, "attempted to grow read-only file ", filename);
+      uint64_t auId = blocks.size();
+      writeArrayFile(fd, plug, au_size);
+      size_t pageSize = fileSizeMultiple(),
+	start = auId * au_size + sizeof(header_t),
+	realStart = start / pageSize * pageSize,
+	entryPad = start - realStart,
+	realLength = au_size + entryPad;
+      void* mm = WITE::mmapFile(fd, realStart, realLength);
+      mmapedRegions.emplace_back(mm, realLength);
+      blocks.push_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + entryPad));
+      initialize(auId);
+    };
+
+    //takes the top of the free space queue and appends it to the allocated list
+    uint64_t popFreeSpace_unsafe() {
+      ASSERT_TRAP(!readOnly, "attempted to allocate from read-only file ", filename);
+      ASSERT_TRAP(header->freeSpaceLen, "disk allocation failed?");
+      uint64_t ret = freeSpaceLEA(--header->freeSpaceLen);
+#if DEBUG
+      auto iter = freeSpaceBitmap.find(ret);
+      ASSERT_TRAP(iter != freeSpaceBitmap.end(), "allocated entity from free space queue not in bitmap ", ret);
+      freeSpaceBitmap.erase(iter);
+#endif
+      link_t& l = allocatedLEA(ret);
+      l.previous = header->allocatedLast;//might be NONE
+      l.next = NONE;
+      if(header->allocatedFirst == NONE) [[unlikely]] {//list was empty
+	header->allocatedFirst = ret;
+      } else {
+	ASSERT_TRAP(header->allocatedLast != NONE, "root node in invalid state");
+	link_t& oldLast = allocatedLEA(header->allocatedLast);
+	ASSERT_TRAP(oldLast.next == NONE, "last node didn't know it was last.");
+	oldLast.next = ret;
+      }
+      header->allocatedLast = ret;
+      return ret;
+    };
+
   public:
+    struct readOnly_t {};
+    static constexpr readOnly_t readOnlyTag {};
+
     dbFile() = delete;
     dbFile(dbFile&&) = delete;
 
+    //maps an existing file read-only under a shared lock, for replicas. Only reads (deref, get, iteration, isAllocated) are allowed.
+    dbFile(const std::filesystem::path& fn, readOnly_t) : filename(fn), readOnly(true) {
+      scopeLock fl(&fileMutex);
+      concurrentReadLock_write bm(&blocksMutex), am(&allocationMutex);
+      fd = WITE::openFileReadOnly(filename);
+      ASSERT_TRAP_OR_RUN(WITE::lockFileShared(fd), "failed to lock file ", filename);
+      fileSize = static_cast<size_t>(std::filesystem::file_size(filename));
+      ASSERT_TRAP(fileSize > sizeof(header_t) && (fileSize - sizeof(header_t)) % au_size == 0, "attempted to load file with invalid size");
+      size_t existingAUs = (fileSize - sizeof(header_t)) / au_size;
+      void* mm = WITE::mmapFileReadOnly(fd, 0, fileSize);
+      mmapedRegions.emplace_back(mm, fileSize);
+      header = reinterpret_cast<header_t*>(mm);
+      blocks.push_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + sizeof(header_t)));
+      for(uint64_t i = 1;i < existingAUs;i++)
+	blocks.push_back(blocks[0] + i);
+    };
+
     dbFile(const std::filesystem::path& fn, bool clobber) : filename(fn) {
       scopeLock fl(&fileMutex);
       concurrentReadLock_write bm(&blocksMutex), am(&allocationMutex);
@@ -113,18 +176,19 @@ namespace WITE {
       void* mm = WITE::mmapFile(fd, 0, fileSize);
       mmapedRegions.emplace_back(mm, fileSize);
       header = reinterpret_cast<header_t*>(mm);
-      blocks.emplace_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + sizeof(header_t)));
+      blocks.push_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + sizeof(header_t)));
       if(existingAUs) [[likely]] {
+	//if the file contains multiple allocation units, then those all share one large mmap, but still populate `blocks` with portions of that mmap rather than complicate the logic of deciding which map to use
+	for(uint64_t i = 1;i < existingAUs;i++)
+	  blocks.push_back(blocks[0] + i);
 #if DEBUG
+	//after blocks is populated, because the queue spans every allocation unit
 	ASSERT_TRAP(header->freeSpaceLen <= existingAUs * AU, "invalid free space length (recovery nyi)");
 	for(uint64_t i = 0;i < header->freeSpaceLen;i++) {
 	  uint64_t j = freeSpaceLEA(i);
 	  ASSERT_TRAP(freeSpaceBitmap.emplace(j).second, "duplicate entity found in free space queue ", j);
 	}
 #endif
-	//if the file contains multiple allocation units, then those all share one large mmap, but still populate `blocks` with portions of that mmap rather than complicate the logic of deciding which map to use
-	for(uint64_t i = 1;i < existingAUs;i++)
-	  blocks.emplace_back(blocks[0] + i);
       } else {//initialize file contents
 	initialize(0);
       }
@@ -153,37 +217,9 @@ namespace WITE {
       if(!header->freeSpaceLen) [[unlikely]] {
 	scopeLock fl(&fileMutex);
 	concurrentReadLock_write bm(&blocksMutex);
-	uint64_t auId = blocks.size();
-	writeArrayFile(fd, plug, au_size);
-	size_t pageSize = fileSizeMultiple(),
-	  start = auId * au_size + sizeof(header_t),
-	  realStart = start / pageSize * pageSize,
-	  entryPad = start - realStart,
-	  realLength = au_size + entryPad;
-	void* mm = WITE::mmapFile(fd, realStart, realLength);
-	mmapedRegions.emplace_back(mm, realLength);
-	blocks.emplace_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + entryPad));
-	initialize(auId);
-      }
-      ASSERT_TRAP(header->freeSpaceLen, "disk allocation failed?");
-      ret = freeSpaceLEA(--header->freeSpaceLen);
-#if DEBUG
-      auto iter = freeSpaceBitmap.find(ret);
-      ASSERT_TRAP(iter != freeSpaceBitmap.end(), "allocated entity from free space queue not in bitmap ", ret);
-      freeSpaceBitmap.erase(iter);
-#endif
-      link_t& l = allocatedLEA(ret);
-      l.previous = header->allocatedLast;//might be NONE
-      l.next = NONE;
-      if(header->allocatedFirst == NONE) [[unlikely]] {//list was empty
-	header->allocatedFirst = ret;
-      } else {
-	ASSERT_TRAP(header->allocatedLast != NONE, "root node in invalid state");
-	link_t& oldLast = allocatedLEA(header->allocatedLast);
-	ASSERT_TRAP(oldLast.next == NONE, "last node didn't know it was last.");
-	oldLast.next = ret;
+	grow_unsafe();
       }
-      header->allocatedLast = ret;
+      ret = popFreeSpace_unsafe();
       WITE_DEBUG_DB_HEADER;
 #ifdef WITE_DEBUG_DB
       WARN("dbFile: ", filename, "Allocated: ", ret);
@@ -194,38 +230,9 @@ namespace WITE {
     uint64_t allocate_unsafe() {
       uint64_t ret;
       WITE_DEBUG_DB_HEADER;
-      if(!header->freeSpaceLen) [[unlikely]] {
-	uint64_t auId = blocks.size();
-	writeArrayFile(fd, plug, au_size);
-	size_t pageSize = fileSizeMultiple(),
-	  start = auId * au_size + sizeof(header_t),
-	  realStart = start / pageSize * pageSize,
-	  entryPad = start - realStart,
-	  realLength = au_size + entryPad;
-	void* mm = WITE::mmapFile(fd, realStart, realLength);
-	mmapedRegions.emplace_back(mm, realLength);
-	blocks.emplace_back(reinterpret_cast<au_t*>(reinterpret_cast<uint8_t*>(mm) + entryPad));
-	initialize(auId);
-      }
-      ASSERT_TRAP(header->freeSpaceLen, "disk allocation failed?");
-      ret = freeSpaceLEA(--header->freeSpaceLen);
-#if DEBUG
-      auto iter = freeSpaceBitmap.find(ret);
-      ASSERT_TRAP(iter != freeSpaceBitmap.end(), "allocated entity from free space queue not in bitmap ", ret);
-      freeSpaceBitmap.erase(iter);
-#endif
-      link_t& l = allocatedLEA(ret);
-      l.previous = header->allocatedLast;//might be NONE
-      l.next = NONE;
-      if(header->allocatedFirst == NONE) [[unlikely]] {//list was empty
-	header->allocatedFirst = ret;
-      } else {
-	ASSERT_TRAP(header->allocatedLast != NONE, "root node in invalid state");
-	link_t& oldLast = allocatedLEA(header->allocatedLast);
-	ASSERT_TRAP(oldLast.next == NONE, "last node didn't know it was last.");
-	oldLast.next = ret;
-      }
-      header->allocatedLast = ret;
+      if(!header->freeSpaceLen) [[unlikely]]
+	grow_unsafe();
+      ret = popFreeSpace_unsafe();
       WITE_DEBUG_DB_HEADER;
 #ifdef WITE_DEBUG_DB
       WARN("dbFile: ", filename, "Allocated: ", ret);
@@ -233,6 +240,24 @@ namespace WITE {
       return ret;
     };
 
+    //allocates the given id, which must be free, growing the file if needed. For restoring rows whose ids are already known.
+    //cost is linear in the number of free ids above idx in the queue, so restoring in descending id order is best
+    void allocateSpecific(uint64_t idx) {
+      concurrentReadLock_write am(&allocationMutex);//same order as allocate
+      scopeLock fl(&fileMutex);
+      concurrentReadLock_write bm(&blocksMutex);
+      while(capacity_unsafe() <= idx)
+	grow_unsafe();
+      uint64_t i = header->freeSpaceLen;
+      do {
+	ASSERT_TRAP(i, "attempted to allocate specific id that is already allocated: ", idx);
+	i--;
+      } while(freeSpaceLEA(i) != idx);
+      std::swap(freeSpaceLEA(i), freeSpaceLEA(header->freeSpaceLen - 1));
+      popFreeSpace_unsafe();
+      WITE_DEBUG_DB_HEADER;
+    };
+
     //NOTE: free might break an iterator (if the iteratee is freed)
     void free(uint64_t idx) {
       concurrentReadLock_write am(&allocationMutex);
@@ -240,6 +265,7 @@ namespace WITE {
     };
 
     void free_unsafe(uint64_t idx) {
+      ASSERT_TRAP(!readOnly, "attempted to free from read-only file ", filename);
 #ifdef WITE_DEBUG_DB
       WARN("dbFile: ", filename, "Freeing: ", idx);
 #endif
@@ -266,8 +292,8 @@ namespace WITE {
       WITE_DEBUG_DB_HEADER;
     };
 
+    //no lock: blocks never move once published, and the reference outlives any lock taken here anyway
     T& deref(uint64_t idx) {
-      concurrentReadLock_read bm(&blocksMutex);
       return deref_unsafe(idx);
     };
 
@@ -276,6 +302,22 @@ namespace WITE {
       return blocks[idx / AU]->data[idx % AU];
     };
 
+    //for optimistic readers that might be holding a torn id: NULL instead of a trap if idx is not backed by the file
+    inline T* find_unsafe(uint64_t idx) {
+      if(idx / AU >= blocks.size()) [[unlikely]] return NULL;
+      return &blocks[idx / AU]->data[idx % AU];
+    };
+
+    //the allocated list is doubly linked, so idx is allocated exactly when its predecessor (or the header) points to it. Rows that were never allocated have zeroed links, which this also handles.
+    inline bool isAllocated(uint64_t idx) {
+      concurrentReadLock_read am(&allocationMutex);
+      if(idx >= capacity_unsafe()) [[unlikely]] return false;
+      const uint64_t previous = allocatedLEA(idx).previous;
+      if(previous == NONE)
+	return header->allocatedFirst == idx;
+      return previous < capacity_unsafe() && allocatedLEA(previous).next == idx;
+    };
+
     inline T* get(uint64_t idx) {
       if(idx == NONE) return NULL;
       return &deref(idx);
@@ -357,8 +399,7 @@ namespace WITE {
     };
 
     inline uint64_t capacity() {
-      concurrentReadLock_read bm(&blocksMutex);
-      return capacity_unsafe();
+      return capacity_unsafe();//blocks.size() is atomic
     };
 
     inline uint64_t capacity_unsafe() {
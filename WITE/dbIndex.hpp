@@ -15,12 +15,35 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #pragma once
 
 #include <concepts>
+#include <bit>
+#include <string>
 
 #include "dbFile.hpp"
-#include "concurrentReadSyncLock.hpp"
+#include "syncLock.hpp"
+#include "thread.hpp"
+#include "profiler.hpp"
 
 namespace WITE {
 
+  //composite keys need no special type: a std::tuple compares lexicographically, so one index on std::tuple<A, B> serves queries on A alone (range from {a, lowest} to {a, max}) as well as on A and B together.
+
+  //covering index value: only key participates in ordering, so queries and ranges are on the key alone. The payload is stored in the index node and passed to forEach callbacks, so queries that only need the payload can be answered without reading the table.
+  //equality includes the payload so that an object whose payload changed (but not its key) still gets its index entry updated
+  template<class K, class P, class Compare = std::less<K>> struct dbCovering {
+    K key;
+    P payload;
+
+    dbCovering() = default;
+    dbCovering(const K& key) : key(key), payload() {};//for query bounds, payload is ignored
+    dbCovering(const K& key, const P& payload) : key(key), payload(payload) {};
+
+    bool operator==(const dbCovering& o) const = default;
+
+    bool operator<(const dbCovering& o) const {
+      return Compare()(key, o.key);
+    };
+  };
+
   //not to be embedded into a datatype or database, but should target data that is
   //ideally the per-record value of the field being indexed should not change. If it does, it is the caller's responsibility to call update()
   //rebalance should be called externally after significant cumulative changes
@@ -45,39 +68,24 @@ namespace WITE {
 	return *this <=> r.targetValue;
       };
 
-      uint64_t findAny(const F& v, dbIndex* owner) {
-	auto comp = *this <=> v;
-	if(comp == 0) return target;
-	uint64_t nid = comp < 0 ? high : low;
-	return nid == NONE ? NONE : owner->file.deref_unsafe(nid).findAny(v, owner);
-      };
-
-      //for range [l, h] (inclusive, same for exact match)
-      //lambda callback because iterating a btree is inefficient without recursion on the thread stack
-      template<class L> void forEach(const F& l, const F& h, L cb, dbIndex* owner) {
-	ASSERT_TRAP(!Compare()(h, l), "inside-out range not supported");
-	//(un)likely: when outside range, exactly one of low or high will happen and this call will not
-	//but while inside range, all three will happen, so low and high are slightly >50% likely
-	if(low != NONE && !Compare()(targetValue, l)) [[likely]]
-	  owner->file.deref_unsafe(low).forEach(l, h, cb, owner);
-	if(!Compare()(targetValue, l) && !Compare()(h, targetValue)) [[unlikely]]
-	  //if l <= tv && tv <= h  but in terms of Compare
-	  cb(const_cast<const F&>(targetValue), target);
-	if(high != NONE && !Compare()(h, targetValue)) [[likely]]
-	  owner->file.deref_unsafe(high).forEach(l, h, cb, owner);
+      //total order used for tree placement: value, then target, then node id, so that every entry has a distinct position a cursor can resume from
+      std::strong_ordering order(uint64_t thisId, const F& v, uint64_t t, uint64_t nid) const {
+	auto ret = *this <=> v;
+	if(ret == 0) [[unlikely]] ret = target <=> t;
+	if(ret == 0) [[unlikely]] ret = thisId <=> nid;
+	return ret;
       };
 
       //can't store owner as a field bc node is on disk and outlives its owner
-      void insert(uint64_t entity, const F& v, dbIndex* owner) {
-	uint64_t& next = *this < v ? high : low;
+      //@param nid already allocated and populated, to be linked in
+      //@returns depth of the new node below this one
+      uint64_t insert(uint64_t thisId, uint64_t nid, const node& n, dbIndex* owner) {
+	uint64_t& next = order(thisId, n.targetValue, n.target, nid) < 0 ? high : low;
 	if(next != NONE) [[likely]] {
-	  owner->file.deref_unsafe(next).insert(entity, v, owner);
+	  return 1 + owner->file.deref_unsafe(next).insert(next, nid, n, owner);
 	} else {
-	  next = owner->file.allocate_unsafe();
-	  node& n = owner->file.deref_unsafe(next);
-	  n.targetValue = v;
-	  n.target = entity;
-	  n.high = n.low = NONE;
+	  next = nid;
+	  return 1;
 	}
       };
 
@@ -131,11 +139,6 @@ namespace WITE {
 	return lowCnt + highCnt + 1;
       };
 
-      uint64_t depth(dbIndex* owner) {
-	return max(high == NONE ? 0 : owner->file.deref_unsafe(high).depth(owner),
-		   low == NONE ? 0 : owner->file.deref_unsafe(low).depth(owner)) + 1;
-      };
-
       //@param thisId is updated if this node is moved
       //@returns number of rotations made
       uint64_t rebalance(dbIndex* owner, uint64_t& thisId) {
@@ -187,87 +190,426 @@ namespace WITE {
     };
 
     dbFile<node, 65536/sizeof(node)+1> file;//shoot for 64kb page
-    concurrentReadSyncLock mutex;
-    //this lock protects the underlaying dbFile too, so the "unsafe" endpoints are used to avoid locking every single node many times per operation. The file MUST NOT be accessed from outside this api.
+    syncLock writeMutex { "dbIndex::writeMutex" };
+    //writers serialize on writeMutex, which also protects the underlaying dbFile, so the "unsafe" endpoints are used to avoid locking every single node many times per operation. The file MUST NOT be accessed from outside this api.
+    std::atomic_uint64_t version = 0;
+    //seqlock: version is odd while a write is in progress. Readers take no lock at all; they validate that the version did not change during their traversal and retry if it did, so lookups never block writers and writers never wait for readers.
+    uint64_t rootId;//pseudo node that holds a reference to the real root node (high), and the height (target) so opening an index doesn't walk it
+
+    //maintained statistics. All counters are relaxed: they are for monitoring and query planning, not synchronization.
+    static constexpr size_t histogramBuckets = 16;
+    std::atomic_uint64_t height = 0;//upper bound: exact after rebalance, clear or refreshStats, grown by inserts, not shrunk by removes
+    struct alignas(64) lookupCounts_t {
+      std::atomic_uint64_t lookups = 0, nodesVisited = 0;//only written by the owning thread
+    };
+    threadResource<lookupCounts_t> lookupCounts;//per thread, so readers never share a written cache line
+    syncLock statsMutex { "dbIndex::statsMutex" };//protects histogram and histogramEntries
+    std::vector<F> histogram;//equi-depth: histogramBuckets+1 quantiles, first is the lowest value and last the highest. Empty until the first rebalance or refreshStats.
+    uint64_t histogramEntries = 0;//entry count when histogram was built
+    bool degenerateWarned = false;
+    const std::string name;
+
+    struct stats {
+      uint64_t entries, height, lookups, nodesVisited, histogramEntries;
+      std::vector<F> histogram;
+
+      inline double visitedPerLookup() const {
+	return lookups ? nodesVisited / (double)lookups : 0;
+      };
+
+      //a balanced tree of n entries has height bit_width(n). Allow some slack for the incremental inserts between rebalances.
+      inline bool degenerate() const {
+	return height > 2 * std::bit_width(entries) + 8;
+      };
+    };
+
+    struct writeGuard {
+      dbIndex* owner;
+      scopeLock lock;
+      writeGuard(dbIndex* owner) : owner(owner), lock(&owner->writeMutex) {
+	owner->version.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+      };
+      ~writeGuard() {
+	owner->version.fetch_add(1, std::memory_order_release);
+      };
+    };
+
+    inline uint64_t readBegin(uint32_t& sleepCnt) {
+      uint64_t ret = version.load(std::memory_order_acquire);
+      while(ret & 1) [[unlikely]] {
+	thread::sleepShort(sleepCnt);
+	ret = version.load(std::memory_order_acquire);
+      }
+      return ret;
+    };
+
+    inline void countLookup(uint64_t visited) {
+      lookupCounts_t& c = *lookupCounts.get();
+      c.lookups.store(c.lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      c.nodesVisited.store(c.nodesVisited.load(std::memory_order_relaxed) + visited, std::memory_order_relaxed);
+    };
+
+    //caller must hold writeMutex
+    inline void setHeight_unsafe(uint64_t h) {
+      file.deref_unsafe(rootId).target = h;
+      height.store(h, std::memory_order_relaxed);
+    };
+
+    inline bool readValid(uint64_t ver) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return version.load(std::memory_order_relaxed) == ver;
+    };
+
+    //NULL if a writer has invalidated this read (which also covers any torn node id read since the last check)
+    inline node* readNode(uint64_t nid, uint64_t ver) {
+      if(!readValid(ver)) [[unlikely]] return NULL;
+      return file.find_unsafe(nid);
+    };
+
+    //for range [l, h] (inclusive, same for exact match)
+    //returns false if the read was invalidated, in which case the visitor may have seen garbage and the caller must retry
+    template<class V> bool visit(uint64_t nid, const F& l, const F& h, uint64_t ver, V& visitor, uint64_t& visited) {
+      node* n = readNode(nid, ver);
+      if(!n) [[unlikely]] return false;
+      visited++;
+      const uint64_t low = n->low, high = n->high, target = n->target;
+      const F tv = n->targetValue;
+      //(un)likely: when outside range, exactly one of low or high will happen and this call will not
+      //but while inside range, all three will happen, so low and high are slightly >50% likely
+      if(low != NONE && !Compare()(tv, l)) [[likely]]
+	if(!visit(low, l, h, ver, visitor, visited)) [[unlikely]]
+	  return false;
+      if(!Compare()(tv, l) && !Compare()(h, tv)) [[unlikely]]
+	//if l <= tv && tv <= h  but in terms of Compare
+	visitor(tv, target);
+      if(high != NONE && !Compare()(h, tv)) [[likely]]
+	if(!visit(high, l, h, ver, visitor, visited)) [[unlikely]]
+	  return false;
+      return true;
+    };
+
+    //caller must hold writeMutex
+    void refreshStats_unsafe() {
+      uint64_t nid = file.deref_unsafe(rootId).high, maxDepth = 0;
+      //in-order walk with an explicit stack (so depth can't overflow the call stack), picking out the quantiles and the height
+      const uint64_t entries = file.size_unsafe() - 1;
+      std::vector<F> h;
+      if(entries) [[likely]] {
+	h.reserve(histogramBuckets + 1);
+	std::vector<std::pair<uint64_t, uint64_t>> stack;//node, depth
+	uint64_t i = 0, depth = 0;
+	while(nid != NONE || stack.size()) {
+	  while(nid != NONE) {
+	    stack.emplace_back(nid, ++depth);
+	    nid = file.deref_unsafe(nid).low;
+	  }
+	  depth = stack.back().second;
+	  node& n = file.deref_unsafe(stack.back().first);
+	  stack.pop_back();
+	  maxDepth = max(maxDepth, depth);
+	  while(h.size() <= histogramBuckets && i == (entries - 1) * h.size() / histogramBuckets)//loop because small trees repeat values
+	    h.push_back(n.targetValue);
+	  i++;
+	  nid = n.high;
+	}
+	ASSERT_TRAP(h.size() == histogramBuckets + 1, "histogram build failed, node count does not match file size");
+      }
+      setHeight_unsafe(maxDepth);
+      scopeLock lock(&statsMutex);
+      histogram = std::move(h);
+      histogramEntries = entries;
+    };
 
-    dbIndex(const std::filesystem::path& fn, bool clobber) : file(fn, clobber) {
+    dbIndex(const std::filesystem::path& fn, bool clobber) : file(fn, clobber), name(fn.filename().string()) {
       //file.first_unsafe() is used to track the pseudo node that holds a reference to the root node (high)
       if(file.first_unsafe() == NONE) {
 	node& n = file.deref_unsafe(file.allocate_unsafe());
 	n.low = n.high = NONE;
+	n.target = 0;
       }
+      rootId = file.first_unsafe();
+      height.store(file.deref_unsafe(rootId).target, std::memory_order_relaxed);
+#ifdef DO_PROFILE
+      profiler::addStatsSource(this, [this](std::ostream& out) {
+	stats s = getStats();
+	out << "index " << name << ": 	entries: " << s.entries << " 	height: " << s.height <<
+	  " 	lookups: " << s.lookups << " 	visited per lookup: " << s.visitedPerLookup() <<
+	  (s.degenerate() ? " 	DEGENERATE" : "") << "\n";
+      });
+#endif
+    };
+
+#ifdef DO_PROFILE
+    ~dbIndex() {
+      profiler::removeStatsSource(this);
     };
+#endif
 
     void clear() {
-      concurrentReadLock_write lock(&mutex);
-      uint64_t root = file.first_unsafe();
+      writeGuard lock(this);
       for(uint64_t eid : file)
-	if(eid != root) [[likely]]
+	if(eid != rootId) [[likely]]
 	  file.free_unsafe(eid);
-      node& n = file.deref_unsafe(root);
+      node& n = file.deref_unsafe(rootId);
       n.high = n.low = NONE;
+      refreshStats_unsafe();
     };
 
     //returns number of records in index
     uint64_t rebalance() {//probably very slow
-      concurrentReadLock_write lock(&mutex);
-      uint64_t& nid = file.deref_unsafe(file.first_unsafe()).high;
+      writeGuard lock(this);
+      uint64_t& nid = file.deref_unsafe(rootId).high;
       if(nid == NONE) [[unlikely]] return 0;
-      return file.deref_unsafe(nid).rebalance(this, nid);
+      uint64_t ret = file.deref_unsafe(nid).rebalance(this, nid);
+      refreshStats_unsafe();
+      degenerateWarned = false;
+      return ret;
+    };
+
+    //recomputes the exact height and the histogram. O(n) but does not block readers.
+    void refreshStats() {
+      scopeLock lock(&writeMutex);
+      refreshStats_unsafe();
+    };
+
+    stats getStats() {
+      stats ret { count(), height.load(std::memory_order_relaxed), 0, 0 };
+      for(lookupCounts_t& c : lookupCounts) {
+	ret.lookups += c.lookups.load(std::memory_order_relaxed);
+	ret.nodesVisited += c.nodesVisited.load(std::memory_order_relaxed);
+      }
+      scopeLock lock(&statsMutex);
+      ret.histogramEntries = histogramEntries;
+      ret.histogram = histogram;
+      return ret;
+    };
+
+    //warns (once, until the next rebalance) if the index has degenerated. Intended to be polled after a batch of changes.
+    //returns true if degenerate
+    bool checkHealth() {
+      stats s { count(), height.load(std::memory_order_relaxed) };
+      if(!s.degenerate()) [[likely]] return false;
+      if(!degenerateWarned) {
+	//height is only an upper bound, so confirm before warning
+	refreshStats();
+	s.height = height.load(std::memory_order_relaxed);
+	if(!s.degenerate()) return false;
+	degenerateWarned = true;
+	WARN("index ", name, " has degenerated: height ", s.height, " for ", s.entries, " entries. It should be rebalanced.");
+      }
+      return true;
+    };
+
+    //estimated number of entries in [l, h] from the histogram, without walking the tree: a bucket fully inside the range counts fully, one partially inside counts half. Falls back to an exact count if there is no histogram yet.
+    uint64_t estimateCount(const F& l, const F& h) {
+      ASSERT_TRAP(!Compare()(h, l), "inside-out range not supported");
+      double ret = 0;
+      uint64_t entries = count();
+      {
+	scopeLock lock(&statsMutex);
+	if(histogram.size() && histogramEntries) [[likely]] {
+	  for(size_t i = 0;i < histogramBuckets;i++) {
+	    const F& bl = histogram[i], & bh = histogram[i+1];
+	    if(Compare()(bh, l) || Compare()(h, bl)) continue;//outside
+	    ret += (Compare()(bl, l) || Compare()(h, bh)) ? 0.5 : 1;
+	  }
+	  return ret * entries / histogramBuckets;
+	}
+      }
+      return count(l, h);
     };
 
     uint64_t count() {
-      concurrentReadLock_read lock(&mutex);
-      return file.size_unsafe() - 1;//root node always exists and doesn't count
+      uint32_t sleepCnt = 0;
+      while(true) {
+	uint64_t ver = readBegin(sleepCnt);
+	uint64_t ret = file.size_unsafe() - 1;//root node always exists and doesn't count
+	if(readValid(ver)) [[likely]] return ret;
+      }
     };
 
     uint64_t findAny(const F& v) {
-      concurrentReadLock_read lock(&mutex);
-      uint64_t nid = file.deref_unsafe(file.first_unsafe()).high;
-      if(nid == NONE) [[unlikely]]
-	return NONE;
-      return file.deref_unsafe(nid).findAny(v, this);
+      uint32_t sleepCnt = 0;
+      uint64_t visited = 0;
+      while(true) {
+	uint64_t ver = readBegin(sleepCnt), ret = NONE;
+	node* n = readNode(rootId, ver);
+	uint64_t nid = n ? n->high : NONE;
+	while(n && nid != NONE) {
+	  n = readNode(nid, ver);
+	  if(!n) [[unlikely]] break;
+	  visited++;
+	  auto comp = *n <=> v;
+	  if(comp == 0) {
+	    ret = n->target;
+	    break;
+	  }
+	  nid = comp < 0 ? n->high : n->low;
+	}
+	if(n && readValid(ver)) [[likely]] {
+	  countLookup(visited);
+	  return ret;
+	}
+      }
     };
 
+    //matches are collected and validated before any callback is made, so cb sees each match exactly once even if the traversal had to be retried. cb may safely query this index again.
     template<class L> void forEach(const F& l, const F& h, L cb) {
-      concurrentReadLock_read lock(&mutex);
-      uint64_t nid = file.deref_unsafe(file.first_unsafe()).high;
-      if(nid == NONE) [[unlikely]] return;
-      file.deref_unsafe(nid).forEach(l, h, cb, this);
+      ASSERT_TRAP(!Compare()(h, l), "inside-out range not supported");
+      typedef std::pair<F, uint64_t> result_t;
+      static thread_local std::vector<result_t> results;//shared by nested calls on this thread, each uses the tail past its own base
+      const size_t base = results.size();
+      uint32_t sleepCnt = 0;
+      uint64_t visited = 0;
+      auto collector = [](const F& v, uint64_t target) { results.emplace_back(v, target); };
+      while(true) {
+	uint64_t ver = readBegin(sleepCnt);
+	node* n = readNode(rootId, ver);
+	uint64_t nid = n ? n->high : NONE;
+	if(n && (nid == NONE || visit(nid, l, h, ver, collector, visited)) && readValid(ver)) [[likely]]
+	  break;
+	results.resize(base);
+      }
+      countLookup(visited);
+      const size_t end = results.size();
+      for(size_t i = base;i < end;i++) {
+	const result_t r = results[i];//copy: cb might append (nested query) which could reallocate
+	cb(const_cast<const F&>(r.first), r.second);
+      }
+      results.resize(base);
     };
 
     template<class L> void forEach(const F& v, L cb) {
       forEach(v, v, cb);
     };
 
-    //TODO make a dedicated recursive fn in node rather than using forEach
+    uint64_t count(const F& l, const F& h) {
+      ASSERT_TRAP(!Compare()(h, l), "inside-out range not supported");
+      uint32_t sleepCnt = 0;
+      uint64_t ret, visited = 0;
+      auto counter = [&ret](const F&, uint64_t) { ++ret; };
+      while(true) {
+	ret = 0;
+	uint64_t ver = readBegin(sleepCnt);
+	node* n = readNode(rootId, ver);
+	uint64_t nid = n ? n->high : NONE;
+	if(n && (nid == NONE || visit(nid, l, h, ver, counter, visited)) && readValid(ver)) [[likely]] {
+	  countLookup(visited);
+	  return ret;
+	}
+      }
+    };
+
     uint64_t count(const F& v) {
-      uint64_t ret = 0;
-      forEach(v, v, [&ret](const F& v, uint64_t){ ++ret; });
-      return ret;
+      return count(v, v);
     };
 
     void remove(const F& v, uint64_t id = NONE) {
-      concurrentReadLock_write lock(&mutex);
-      uint64_t& nid = file.deref_unsafe(file.first_unsafe()).high;
+      writeGuard lock(this);
+      uint64_t& nid = file.deref_unsafe(rootId).high;
       if(nid == NONE) [[unlikely]] return;
       file.deref_unsafe(nid).remove(v, id, this, nid);
     };
 
     void insert(uint64_t entity, const F& v) {
-      concurrentReadLock_write lock(&mutex);
-      uint64_t& nid = file.deref_unsafe(file.first_unsafe()).high;
-      if(nid == NONE) [[unlikely]] { //first insert
-	nid = file.allocate_unsafe();
-	node& n = file.deref_unsafe(nid);
-	n.target = entity;
-	n.targetValue = v;
-	n.high = n.low = NONE;
-      } else {
-	file.deref_unsafe(nid).insert(entity, v, this);
+      writeGuard lock(this);
+      uint64_t newId = file.allocate_unsafe();
+      node& n = file.deref_unsafe(newId);
+      n.target = entity;
+      n.targetValue = v;
+      n.high = n.low = NONE;
+      uint64_t& nid = file.deref_unsafe(rootId).high;
+      uint64_t depth = 1;
+      if(nid == NONE) [[unlikely]] //first insert
+	nid = newId;
+      else
+	depth += file.deref_unsafe(nid).insert(nid, newId, n, this);
+      if(depth > height.load(std::memory_order_relaxed)) [[unlikely]]
+	setHeight_unsafe(depth);
+    };
+
+    //a position in the index that can be stored and resumed from later, including in a later frame. Entries are ordered by value, then by target, then by node id.
+    //a fresh cursor from seek() or seekBack() sits between entries, so the first next() or prev() (respectively) returns the first entry in range. After that, the cursor sits on the returned entry and value and target describe it.
+    //if the entry under a cursor is removed, the cursor remains valid and continues from where that entry was.
+    struct cursor {
+      F value;
+      uint64_t target = 0, nodeId = 0;
+      bool inclusive = true;//true if an entry exactly at this position has not yet been returned
+    };
+
+    //cursor for iterating forward from the first entry >= v
+    static cursor seek(const F& v) {
+      return { v, 0, 0, true };
+    };
+
+    //cursor for iterating backward from the last entry <= v
+    static cursor seekBack(const F& v) {
+      return { v, NONE, NONE, true };
+    };
+
+    //single root-to-leaf descent (no recursion, no stack) to find the nearest entry past c in the given direction
+    //returns false and leaves c unchanged if there is none, so it can be retried later as new entries are inserted
+    template<bool forward> bool step(cursor& c) {
+      uint32_t sleepCnt = 0;
+      uint64_t visited = 0;
+      while(true) {
+	uint64_t ver = readBegin(sleepCnt), found = NONE, foundTarget = NONE;
+	F foundValue {};
+	node* n = readNode(rootId, ver);
+	uint64_t nid = n ? n->high : NONE;
+	while(n && nid != NONE) {
+	  n = readNode(nid, ver);
+	  if(!n) [[unlikely]] break;
+	  visited++;
+	  auto comp = n->order(nid, c.value, c.target, c.nodeId);
+	  if(forward ? comp > 0 || (c.inclusive && comp == 0) : comp < 0 || (c.inclusive && comp == 0)) {
+	    found = nid;
+	    foundValue = n->targetValue;
+	    foundTarget = n->target;
+	    nid = forward ? n->low : n->high;//look for a closer one
+	  } else {
+	    nid = forward ? n->high : n->low;
+	  }
+	}
+	if(n && readValid(ver)) [[likely]] {
+	  countLookup(visited);
+	  if(found == NONE) return false;
+	  c = { foundValue, foundTarget, found, false };
+	  return true;
+	}
       }
     };
 
+    inline bool next(cursor& c) {
+      return step<true>(c);
+    };
+
+    inline bool prev(cursor& c) {
+      return step<false>(c);
+    };
+
+    //calls cb(value, target) for up to limit entries after c, stopping early at the first entry beyond bound (> bound going forward, < bound going backward), or when cb returns false (if cb returns bool)
+    //c is left on the last entry passed to cb, so the next call continues with the next page. Returns the number of entries passed to cb.
+    //each step is individually consistent but the page as a whole is not a snapshot: entries inserted or removed concurrently behind the cursor are not revisited.
+    template<bool forward = true, class L> uint64_t page(cursor& c, const F& bound, uint64_t limit, L cb) {
+      uint64_t ret = 0;
+      cursor temp = c;
+      while(ret < limit && step<forward>(temp)) {
+	if(forward ? Compare()(bound, temp.value) : Compare()(temp.value, bound)) [[unlikely]]
+	  break;
+	c = temp;
+	ret++;
+	if constexpr(std::is_same_v<decltype(cb(const_cast<const F&>(temp.value), temp.target)), bool>) {
+	  if(!cb(const_cast<const F&>(temp.value), temp.target)) [[unlikely]]
+	    break;
+	} else {
+	  cb(const_cast<const F&>(temp.value), temp.target);
+	}
+      }
+      return ret;
+    };
+
   };
 
 }
@@ -17,6 +17,8 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include <type_traits>
 
 #include "dbIndex.hpp"
+#include "thread.hpp"
+#include "threadPool.hpp"
 
 namespace WITE {
 
@@ -70,6 +72,9 @@ namespace WITE {
   template<class A, class... Args> extern dbIndexTuple<0, A, Args...> dbIndexTupleTypeFromStdTuple(std::tuple<Args...>);
   //extern is a lie: this function has no body or implementation anywhere, and is never actually called. It is only used to deduce a std::tuple type into the corresponding dbIndexTuple type by automatic parameter deduction
 
+  template<class... Args> extern std::tuple<std::remove_cvref_t<Args>...> dbIndexValuesTypeFromStdTuple(std::tuple<Args...>);
+  //same lie as above: getIndexValues may return references into the record, this deduces the by-value tuple that can be queued
+
   template<class T> struct dbIndexTupleFor {//empty default
     static constexpr bool exists = false;
     dbIndexTupleFor(const std::filesystem::path&, bool) {};
@@ -84,7 +89,22 @@ namespace WITE {
     typedef decltype(T::getIndexValues(0, std::declval<const T&>(), NULL)) tpl;
     typedef decltype(dbIndexTupleTypeFromStdTuple<T>(std::declval<tpl>())) type;
 
+    typedef decltype(dbIndexValuesTypeFromStdTuple(std::declval<tpl>())) values_t;
+    static constexpr size_t count = std::tuple_size_v<values_t>;
+
+    //index maintenance is deferred to the end of the frame. Changes are queued per thread during the update phase and applied in one batch by database::endFrame
+    struct change_t {
+      uint64_t oid;
+      bool hasOld, hasNew;
+      values_t oldValues, newValues;
+    };
+
     type indices;
+    threadResource<std::vector<uint64_t>> pendingWrites;//ids created or written this frame, old and new values are computed at the end of the frame
+    threadResource<std::vector<change_t>> pendingRemovals;//objects destroyed this frame, with the values that are currently in the index
+    std::vector<uint64_t> batchIds;//reused every frame
+    std::vector<change_t> batch;//reused every frame
+    threadPool::counter_t built;//this frame's buildIndexChanges jobs, each index's apply job continues from it
 
     dbIndexTupleFor(const std::filesystem::path& basedir, bool clobber) :
       indices(basedir, clobber) {};
@@ -0,0 +1,241 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <tuple>
+#include <chrono>
+#include <map>
+
+#include "database.hpp"
+#include "configuration.hpp"
+
+namespace WITE {
+
+  //read-only access to one type's master file, see dbReplica
+  template<class R> class dbTableReplica {
+  private:
+    typedef typename dbTable<R>::master_t D;
+    typename dbTable<R>::masterFile_t masterDataFile;
+
+  public:
+    dbTableReplica(const std::filesystem::path& basedir) :
+      masterDataFile(dbTable<R>::masterFilenameFor(basedir, R::dbFileId), dbTable<R>::masterFile_t::readOnlyTag) {};
+
+    //logs are not read, so this is the object as of the last log applied to the master file
+    bool load(uint64_t id, R* out) {
+      if(!masterDataFile.isAllocated(id)) [[unlikely]] return false;
+      const D& master = masterDataFile.deref(id);
+      if(master.lastDeletedFrame > master.lastCreatedFrame) [[unlikely]] return false;
+      ::memcpy(reinterpret_cast<void*>(out), reinterpret_cast<const void*>(&master.data), sizeof(R));
+      return true;
+    };
+
+    //cb(oid, const R&) for every object
+    template<class L> void forEach(L cb) {
+      R data;
+      for(uint64_t id : masterDataFile)
+	if(load(id, &data)) [[likely]]
+	  cb(id, data);
+    };
+
+    uint64_t maxFrame() {
+      uint64_t ret = 0;
+      for(uint64_t id : masterDataFile) {
+	const D& m = masterDataFile.deref(id);
+	ret = max(ret, m.lastLogAppliedFrame, m.lastCreatedFrame, m.lastDeletedFrame);
+      }
+      return ret;
+    };
+
+  };
+
+  //a read-only view of a database's files, for analytics and tools: the master files are mapped read-only under a shared lock, so any number of replicas can read the same files at memory bandwidth.
+  //a running database holds exclusive locks on its own files, so a replica is opened on a copy: either a directory of master files (such as a world that was shut down, or the output of restoreBackup), or a backup directory (see database::requestBackup), which is restored into a private directory first.
+  //no type callbacks are called except getIndexValues (with db = NULL). Indices are rebuilt in a private directory, so none of the source files are ever written.
+  //NOT thread-safe with refresh: reads and index queries may be concurrent with each other, but refresh (which reopens everything) must not be concurrent with anything.
+  template<class... TYPES> class dbReplica {
+  public:
+    enum class source_e { eMaster, eBackup };
+
+  private:
+    template<class R> struct perType {
+      std::unique_ptr<dbTableReplica<R>> table;
+      std::unique_ptr<dbIndexTupleFor<R>> indices;
+    };
+
+    const std::filesystem::path sourceDir, privateDir;
+    const source_e source;
+    const uint64_t refreshIntervalNs;
+    std::tuple<perType<TYPES>...> types;
+    std::unique_ptr<dbBlobStore> blobs;
+    uint64_t frame = NONE, lastRefreshNs = 0;
+    typedef std::map<std::filesystem::path, std::pair<uintmax_t, std::filesystem::file_time_type>> version_t;
+    version_t sourceVersion;
+
+    static inline uint64_t nowNs() {
+      return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()).time_since_epoch().count();
+    };
+
+    template<class A> inline perType<A>& get() {
+      return std::get<perType<A>>(types);
+    };
+
+    inline std::filesystem::path dataDir() {
+      return source == source_e::eMaster ? sourceDir : privateDir / "data";
+    };
+
+    //name, size and modification time of every file in the source directory, so a refresh is only done if something changed. Modification time alone is too coarse.
+    version_t getSourceVersion() {
+      version_t ret;
+      std::error_code ec;
+      for(const auto& entry : std::filesystem::directory_iterator(sourceDir, ec))
+	ret[entry.path()] = { entry.file_size(ec), entry.last_write_time(ec) };
+      return ret;
+    };
+
+    template<uint64_t O, class A, class... IT> inline void insertToAllIndices(uint64_t oid, const std::tuple<IT...>& tpl, dbIndexTuple<0, A, IT...>& idx) {
+      idx.template get<O>().insert(oid, std::get<O>(tpl));
+      if constexpr(O + 1 < sizeof...(IT))
+	insertToAllIndices<O+1, A, IT...>(oid, tpl, idx);
+    };
+
+    template<uint64_t O, class A, class I, class... REST> inline void rebalanceAllIndices(dbIndexTuple<O, A, I, REST...>& idx) {
+      idx->rebalance();
+      if constexpr(sizeof...(REST) > 0)
+	rebalanceAllIndices<O+1, A, REST...>(idx.next());
+    };
+
+    template<class A, class... REST> inline void close() {
+      get<A>().indices.reset();
+      get<A>().table.reset();
+      if constexpr(sizeof...(REST) > 0)
+	close<REST...>();
+    };
+
+    template<class A, class... REST> inline void open() {
+      auto& t = get<A>();
+      t.table = std::make_unique<dbTableReplica<A>>(dataDir());
+      if constexpr(dbIndexTupleFor<A>::exists) {
+	t.indices = std::make_unique<dbIndexTupleFor<A>>(privateDir / "indices", true);
+	auto& idx = *t.indices;
+	t.table->forEach([this, &idx](uint64_t oid, const A& data) {
+	  insertToAllIndices<0, A>(oid, A::getIndexValues(oid, data, NULL), *idx);
+	});
+	rebalanceAllIndices<0, A>(*idx);
+      }
+      if(source == source_e::eMaster)
+	frame = frame == NONE ? t.table->maxFrame() : max(frame, t.table->maxFrame());
+      if constexpr(sizeof...(REST) > 0)
+	open<REST...>();
+    };
+
+  public:
+    //refreshIntervalMs is how often refreshIfDue checks the source for changes, default from configuration option dbreplicarefreshms (default 1000)
+    dbReplica(const std::filesystem::path& sourceDir, source_e source, uint64_t refreshIntervalMs = configuration::getOption("dbreplicarefreshms", 1000ull)) :
+      sourceDir(sourceDir),
+      privateDir(std::filesystem::temp_directory_path() / concat({ "wite_replica_", std::to_string(nowNs()), "_", std::to_string(reinterpret_cast<uintptr_t>(this)) })),
+      source(source),
+      refreshIntervalNs(refreshIntervalMs * 1000000)
+    {
+      refresh();
+    };
+
+    ~dbReplica() {
+      close<TYPES...>();
+      blobs.reset();
+      std::error_code ec;
+      std::filesystem::remove_all(privateDir, ec);
+    };
+
+    //reopens everything from the source, even if nothing changed
+    void refresh() {
+      close<TYPES...>();
+      blobs.reset();
+      sourceVersion = getSourceVersion();
+      frame = NONE;
+      if(source == source_e::eBackup)
+	frame = database<TYPES...>::restoreBackup(sourceDir, dataDir());
+      ASSERT_TRAP(source == source_e::eMaster || frame != NONE, "no usable backup in ", sourceDir);
+      open<TYPES...>();
+      blobs = std::make_unique<dbBlobStore>(dataDir(), dbBlobStore::readOnlyTag);
+      lastRefreshNs = nowNs();
+    };
+
+    //call often (like once per tool loop iteration). Returns true if the data was reloaded, which happens at most once per interval and only if the source has changed.
+    bool refreshIfDue() {
+      if(nowNs() - lastRefreshNs < refreshIntervalNs) [[likely]] return false;
+      lastRefreshNs = nowNs();
+      if(getSourceVersion() == sourceVersion) return false;
+      refresh();
+      return true;
+    };
+
+    //the frame the data reflects
+    inline uint64_t getFrame() {
+      return frame;
+    };
+
+    template<class A> inline bool read(uint64_t oid, A* out) {
+      return get<A>().table->load(oid, out);
+    };
+
+    //zero-copy, valid until the next refresh
+    inline std::span<const uint8_t> readBlob(dbBlobHandle h) {
+      return blobs->read(h);
+    };
+
+    template<class T> inline std::span<const T> readBlobAs(dbBlobHandle h) {
+      std::span<const uint8_t> raw = blobs->read(h);
+      return { reinterpret_cast<const T*>(raw.data()), raw.size() / sizeof(T) };
+    };
+
+    //cb(uint64_t oid, const A& data) for every object of type A
+    template<class A, class L> inline void forEach(L cb) {
+      get<A>().table->forEach(cb);
+    };
+
+    template<class A, size_t idxId> inline uint64_t findByIdx(const auto& value) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't findByIdx when there is no idx");
+      return (*get<A>().indices)->template get<idxId>().findAny(value);
+    };
+
+    template<class A, size_t idxId, class L> inline void foreachByIdx(const auto& value, L l) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't when there is no idx");
+      (*get<A>().indices)->template get<idxId>().forEach(value, l);
+    };
+
+    template<class A, size_t idxId, class L> inline void foreachByIdx(const auto& l, const auto& h, L cb) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't when there is no idx");
+      (*get<A>().indices)->template get<idxId>().forEach(l, h, cb);
+    };
+
+    template<class A, size_t idxId> inline uint64_t countByIdx(const auto& l, const auto& h) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't count when there is no idx");
+      return (*get<A>().indices)->template get<idxId>().count(l, h);
+    };
+
+    //cursors, see dbIndex::cursor
+    template<class A, size_t idxId> inline auto seekByIdx(const auto& value) {
+      static_assert(dbIndexTupleFor<A>::exists, "can't seek when there is no idx");
+      return (*get<A>().indices)->template get<idxId>().seek(value);
+    };
+
+    template<class A, size_t idxId, bool forward = true, class L> inline uint64_t pageByIdx(auto& cursor, const auto& bound, uint64_t limit, L cb) {
+      return (*get<A>().indices)->template get<idxId>().template page<forward>(cursor, bound, limit, cb);
+    };
+
+  };
+
+};
@@ -0,0 +1,202 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <array>
+#include <utility>
+#include <atomic>
+
+#include "dbFile.hpp"
+#include "stdExtensions.hpp"
+
+namespace WITE {
+
+  //each thread gets a home shard, assigned round-robin the first time it allocates from any sharded file
+  inline uint64_t dbHomeShardSeed() {
+    static std::atomic_uint64_t nextSeed;
+    static thread_local uint64_t seed = nextSeed.fetch_add(1, std::memory_order_relaxed);
+    return seed;
+  };
+
+  //N dbFiles behind the dbFile interface. Ids are interleaved: global id = local id * N + shard, so ids stay dense (and bitmaps over them stay small) as long as the shards grow evenly.
+  //allocate goes to the calling thread's home shard, so allocation contention drops with the number of shards. With N = 1 this is a single file with the same name and ids as a plain dbFile, at no cost.
+  template<class T, size_t AU, size_t N> class dbShardedFile {
+  public:
+    static_assert(N > 0);
+    static constexpr size_t shardCount = N;
+    typedef dbFile<T, AU> shard_t;
+    typedef typename shard_t::readOnly_t readOnly_t;
+    static constexpr readOnly_t readOnlyTag {};
+
+  private:
+    std::array<shard_t, N> shards;
+
+    template<class... Args, size_t... I> dbShardedFile(const std::filesystem::path& fn, std::index_sequence<I...>, Args... args) :
+      shards { shard_t(shardFilename(fn, I), args...)... } {};
+
+  public:
+    static std::filesystem::path shardFilename(const std::filesystem::path& fn, size_t shard) {
+      if constexpr(N == 1) {
+	return fn;
+      } else {
+	std::filesystem::path ret = fn;
+	ret.replace_extension();
+	ret += concat({ "_shard", std::to_string(shard) });
+	ret += fn.extension();
+	return ret;
+      }
+    };
+
+    static void removeFiles(const std::filesystem::path& fn) {
+      for(size_t i = 0;i < N;i++)
+	std::filesystem::remove(shardFilename(fn, i));
+    };
+
+    static inline size_t shardOf(uint64_t idx) {
+      return idx % N;
+    };
+
+    static inline uint64_t localOf(uint64_t idx) {
+      return idx / N;
+    };
+
+    static inline uint64_t globalOf(size_t shard, uint64_t local) {
+      return local * N + shard;
+    };
+
+    static inline size_t homeShard() {
+      return N == 1 ? 0 : dbHomeShardSeed() % N;
+    };
+
+    dbShardedFile(const std::filesystem::path& fn, bool clobber) : dbShardedFile(fn, std::make_index_sequence<N>(), clobber) {};
+    dbShardedFile(const std::filesystem::path& fn, readOnly_t ro) : dbShardedFile(fn, std::make_index_sequence<N>(), ro) {};
+
+    void close() {
+      for(shard_t& s : shards)
+	s.close();
+    };
+
+    inline shard_t& shard(size_t s) {
+      return shards[s];
+    };
+
+    inline uint64_t allocate() {
+      return allocateIn(homeShard());
+    };
+
+    //for things that should be near something else, like logs near their master row
+    inline uint64_t allocateIn(size_t shard) {
+      return globalOf(shard, shards[shard].allocate());
+    };
+
+    inline void allocateSpecific(uint64_t idx) {
+      shards[shardOf(idx)].allocateSpecific(localOf(idx));
+    };
+
+    inline void free(uint64_t idx) {
+      shards[shardOf(idx)].free(localOf(idx));
+    };
+
+    inline T& deref(uint64_t idx) {
+      return shards[shardOf(idx)].deref(localOf(idx));
+    };
+
+    inline T* find_unsafe(uint64_t idx) {
+      return shards[shardOf(idx)].find_unsafe(localOf(idx));
+    };
+
+    inline T* get(uint64_t idx) {
+      if(idx == NONE) return NULL;
+      return &deref(idx);
+    };
+
+    inline bool isAllocated(uint64_t idx) {
+      return shards[shardOf(idx)].isAllocated(localOf(idx));
+    };
+
+    //visits each shard in turn
+    class iterator_t {
+    private:
+      dbShardedFile* dbf;
+      size_t s;
+      typename shard_t::iterator_t it;
+
+      inline void skipEmpty() {
+	while(it == dbf->shards[s].end() && ++s < N)
+	  it = dbf->shards[s].begin();
+      };
+
+    public:
+      typedef int64_t difference_type;
+      typedef std::forward_iterator_tag iterator_concept;
+
+      iterator_t() : dbf(NULL), s(N) {};
+      iterator_t(const iterator_t& o) = default;
+      iterator_t(dbShardedFile* dbf) : dbf(dbf), s(0), it(dbf->shards[0].begin()) {
+	skipEmpty();
+      };
+
+      uint64_t operator*() const {
+	return globalOf(s, *it);
+      };
+
+      iterator_t& operator++() {//prefix
+	++it;
+	skipEmpty();
+	return *this;
+      };
+
+      iterator_t operator++(int) {//postfix
+	iterator_t ret = *this;
+	operator++();
+	return ret;
+      };
+
+      inline bool operator==(const iterator_t& r) const {
+	return (s == N && r.s == N) || (dbf == r.dbf && s == r.s && it == r.it);
+      };
+
+      inline bool operator!=(const iterator_t& r) const {
+	return !(*this == r);
+      };
+
+    };
+
+    inline iterator_t begin() {
+      return { this };
+    };
+
+    inline iterator_t end() {
+      return {};
+    };
+
+    //global ids are all below this (but not every id below this is backed by a shard)
+    inline uint64_t capacity() {
+      uint64_t ret = 0;
+      for(shard_t& s : shards)
+	ret = max(ret, s.capacity());
+      return ret * N;
+    };
+
+    inline uint64_t size() {
+      uint64_t ret = 0;
+      for(shard_t& s : shards)
+	ret += s.size();
+      return ret;
+    };
+
+  };
+
+}
@@ -16,11 +16,16 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #include <string>
 #include <map>
+#include <fstream>
+#include <bit>
 
 #include "stdExtensions.hpp"
 #include "shared.hpp"
 #include "dbFile.hpp"
+#include "dbShardedFile.hpp"
 #include "dbUtils.hpp"
+#include "dbChangeFeed.hpp"
+#include "stableVector.hpp"
 
 namespace WITE {
 
@@ -38,7 +43,8 @@ namespace WITE {
     static constexpr size_t TCnt = (sizeof(R) - 1) / sizeof(U) + 1;
     typedef U T[TCnt];
     static constexpr size_t AU = dbAllocationBatchSizeOf<R>::value,
-      AU_LOG = dbLogAllocationBatchSizeOf<R>::value;
+      AU_LOG = dbLogAllocationBatchSizeOf<R>::value,
+      SHARDS = dbShardCountOf<R>::value;
 
     enum class eLogType : uint64_t {
       eUpdate,
@@ -56,12 +62,74 @@ namespace WITE {
       T data;
     };
 
+    //backup file: one header then any number of records
+    static constexpr uint64_t backupMagic = 0x314b414245544957;//"WITEBAK1"
+    struct backupHeader_t {
+      uint64_t magic, rowSize, frame, previousFrame;//previousFrame is the frame of the backup this increment follows, NONE for a full backup
+    };
+    struct backupRecord_t {
+      uint64_t id, createdFrame;//createdFrame is NONE if the object had been destroyed as of the backup's frame (increments only)
+      T data;
+    };
+
     const std::filesystem::path mdfFilename, ldfFilename;
     const std::string typeId;
-    dbFile<D, AU> masterDataFile;
-    dbFile<L, AU_LOG> logDataFile;
+    //logs are allocated in the shard of their row, so each shard's rows and logs can be applied independently of the other shards
+    typedef dbShardedFile<D, AU, SHARDS> mdf_t;
+    typedef dbShardedFile<L, AU_LOG, SHARDS> ldf_t;
+    mdf_t masterDataFile;
+    ldf_t logDataFile;
     std::map<uint64_t, syncLock> rowLocks;
-    syncLock rowLocks_mutex;//only needed for ops that might alter the size of rowLocks
+    syncLock rowLocks_mutex { "dbTable::rowLocks_mutex" };//only needed for ops that might alter the size of rowLocks
+    //one bit per row. live: objects that existed at the start of this frame and have not been freed since. born: allocated this frame, promoted to live by commitFrame. asleep: skipped by updates until woken. woken: woken this frame, applied again by wakeThrough.
+    //these let the update phase be dispatched as a few ranges of words instead of walking the allocated list
+    stableVector<std::atomic_uint64_t> liveBits, bornBits, asleepBits, wokenBits;
+    syncLock bitsMutex { "dbTable::bitsMutex" };//only for growth
+    //timed sleep: sleepUntil is authoritative, wakeups may contain stale entries (from objects that were woken early and slept again) which are ignored
+    std::map<uint64_t, uint64_t> sleepUntil;//oid -> frame
+    std::multimap<uint64_t, uint64_t> wakeups;//frame -> oid
+    syncLock sleepMutex { "dbTable::sleepMutex" };
+    //pipelined log application runs concurrently with readers that may be holding a log or row id it just retired, so those are only freed by releaseQuarantine, between frames
+    //one of each per shard, so shards can be applied concurrently
+    std::array<std::vector<uint64_t>, SHARDS> quarantinedLogs, quarantinedRows;
+    //striped by the calling thread's home shard (see dbHomeShardSeed), independent of how many shards the files have, so threads counting on the same table mostly don't share a cache line
+    static constexpr size_t counterStripes = 8;
+    struct alignas(64) counterStripe_t : public dbTableCounters {};
+    std::array<counterStripe_t, counterStripes> counters;
+
+    dbChunkTuning updateChunking;
+
+    inline dbTableCounters& myCounters() {
+      return counters[dbHomeShardSeed() % counterStripes];
+    };
+    //incremental backups: dirty marks every row created, written or destroyed since the last beginBackup. backupRows is the snapshot of it taken by beginBackup.
+    stableVector<std::atomic_uint64_t> dirtyBits;
+    //change feed: like dirtyBits but cleared every frame by publishChanges, and only kept while trackChanges is set
+    stableVector<std::atomic_uint64_t> changedBits;
+    bool trackChanges = false;
+    std::vector<uint64_t> backupRows;
+    std::filesystem::path backupFilename;
+    uint64_t backupFrame = NONE, backupPreviousFrame = NONE;
+
+    inline void growBits(uint64_t word) {
+      if(liveBits.size() > word) [[likely]] return;
+      scopeLock l(&bitsMutex);
+      while(liveBits.size() <= word) {
+	//born first so that it's always at least as big as live
+	bornBits.emplace_back();
+	bornBits.publish();
+	asleepBits.emplace_back();
+	asleepBits.publish();
+	wokenBits.emplace_back();
+	wokenBits.publish();
+	dirtyBits.emplace_back();
+	dirtyBits.publish();
+	changedBits.emplace_back();
+	changedBits.publish();
+	liveBits.emplace_back();
+	liveBits.publish();
+      }
+    };
 
     void appendLog(uint64_t id, L&& l) {
       D& master = masterDataFile.deref(id);
@@ -71,7 +139,9 @@ namespace WITE {
 	return;
       }
       WITE_DEBUG_DB_MASTER(id);
-      uint64_t nlid = logDataFile.allocate();
+      const size_t shard = mdf_t::shardOf(id);
+      myCounters().logsWritten.fetch_add(1, std::memory_order_relaxed);
+      uint64_t nlid = logDataFile.allocateIn(shard);
       L& nl = logDataFile.deref(nlid);
       nl = l;
       nl.nextLog = NONE;
@@ -89,6 +159,22 @@ namespace WITE {
       WITE_DEBUG_DB_LOG(master.lastLog);
     };
 
+    inline void markDirty(uint64_t id) {
+      const uint64_t bit = uint64_t(1) << (id % 64);
+      auto& word = dirtyBits[id / 64];
+      if(!(word.load(std::memory_order_relaxed) & bit))//most writes are to rows that are already dirty
+	word.fetch_or(bit, std::memory_order_relaxed);
+      if(trackChanges) {
+	auto& changed = changedBits[id / 64];
+	if(!(changed.load(std::memory_order_relaxed) & bit))
+	  changed.fetch_or(bit, std::memory_order_relaxed);
+      }
+    };
+
+    static std::filesystem::path backupFilenameFor(const std::filesystem::path& dir, const std::string& typeId, uint64_t frame) {
+      return dir / concat({ "backup_", typeId, "_", std::to_string(frame), ".wdb" });
+    };
+
     void write(uint64_t id, uint64_t frame, R* data) {
       L log {
 	.type = eLogType::eUpdate,
@@ -96,13 +182,26 @@ namespace WITE {
       };
       memcpy(log.data, *data);
       appendLog(id, std::move(log));
+      markDirty(id);
     };
 
   public:
+    //for read-only access to the master file, see dbReplica
+    typedef D master_t;
+    typedef mdf_t masterFile_t;
+    static constexpr size_t shardCount = SHARDS;
+
+    static inline std::filesystem::path masterFilenameFor(const std::filesystem::path& basedir, const std::string& typeId) {
+      return basedir / concat({ "master_", typeId, ".wdb" });
+    };
+
+    static inline std::filesystem::path logFilenameFor(const std::filesystem::path& basedir, const std::string& typeId) {
+      return basedir / concat({ "log_", typeId, ".wdb" });
+    };
 
     dbTable(const std::filesystem::path& basedir, const std::string& typeId, bool clobberMaster, bool clobberLog) :
-      mdfFilename(basedir / concat({ "master_", typeId, ".wdb" })),
-      ldfFilename(basedir / concat({ "log_", typeId, ".wdb" })),
+      mdfFilename(masterFilenameFor(basedir, typeId)),
+      ldfFilename(logFilenameFor(basedir, typeId)),
       typeId(typeId),
       masterDataFile(mdfFilename, clobberMaster),
       logDataFile(ldfFilename, clobberLog)
@@ -113,6 +212,13 @@ namespace WITE {
 	  m.firstLog = m.lastLog = NONE;
 	}
       }
+      for(uint64_t id : masterDataFile) {
+	const D& m = masterDataFile.deref(id);
+	if(m.lastLog != NONE && logDataFile.deref(m.lastLog).type == eLogType::eDelete) [[unlikely]]
+	  continue;//destroyed, row is only waiting for its delete log to be applied
+	growBits(id / 64);
+	liveBits[id / 64].fetch_or(uint64_t(1) << (id % 64), std::memory_order_relaxed);
+      }
     };
 
     //TODO integrate rollback into constructor if log is not clobbered and exists (a graceful shutdown will delete the log file)
@@ -148,7 +254,7 @@ namespace WITE {
 
     inline syncLock* mutexFor(uint64_t rowIdx) {
       scopeLock l(&rowLocks_mutex);
-      return &rowLocks[rowIdx];
+      return &rowLocks.try_emplace(rowIdx, "dbTable::rowLocks").first->second;
     };
 
     //provided for convenience but NOT used internally. Caller must ensure thread safety in access of individual rows.
@@ -164,23 +270,127 @@ namespace WITE {
       master.firstLog = master.lastLog = NONE;
       master.lastCreatedFrame = frame;
       WITE_DEBUG_DB_MASTER(ret);
+      growBits(ret / 64);
       write(ret, frame, data);
+      bornBits[ret / 64].fetch_or(uint64_t(1) << (ret % 64), std::memory_order_relaxed);
+      myCounters().allocations.fetch_add(1, std::memory_order_relaxed);
       return ret;
     };
 
     //`free` must only be called once for each `allocate`. `store` should never be concurrent with `free` on the same id. `store` should never be called after free on the same id unless that id has since been returned by `allocate`.
+    //the row itself is not released for reuse until the delete log is applied, so readers of older frames still find it and its logs are not leaked
     void free(uint64_t id, uint64_t frame) {
       appendLog(id, L { .type = eLogType::eDelete, .frame = frame });
-      masterDataFile.free(id);
+      const uint64_t mask = ~(uint64_t(1) << (id % 64));
+      liveBits[id / 64].fetch_and(mask, std::memory_order_relaxed);
+      bornBits[id / 64].fetch_and(mask, std::memory_order_relaxed);
+      asleepBits[id / 64].fetch_and(mask, std::memory_order_relaxed);
+      markDirty(id);
+      myCounters().frees.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    //sleeping objects are skipped by forEachLive<true> (updates) until woken by wake or, if untilFrame is not NONE, at the start of frame untilFrame
+    //sleep state is transient: everything is awake after a restart
+    void sleep(uint64_t id, uint64_t untilFrame = NONE) {
+      asleepBits[id / 64].fetch_or(uint64_t(1) << (id % 64), std::memory_order_relaxed);
+      scopeLock l(&sleepMutex);
+      if(untilFrame == NONE) {
+	sleepUntil.erase(id);
+      } else {
+	sleepUntil[id] = untilFrame;
+	wakeups.emplace(untilFrame, id);
+      }
+    };
+
+    //no effect if the object is awake. Takes effect no later than the next frame (if the scan has not yet passed this object, it may be updated in this frame).
+    //a wake wins over a sleep in the same frame whichever lands first: it is recorded and applied again by wakeThrough, after every sleep of the frame.
+    inline void wake(uint64_t id) {
+      const uint64_t bit = uint64_t(1) << (id % 64);
+      auto& woken = wokenBits[id / 64];
+      if(!(woken.load(std::memory_order_relaxed) & bit)) [[unlikely]]
+	woken.fetch_or(bit, std::memory_order_relaxed);
+      auto& word = asleepBits[id / 64];
+      if(word.load(std::memory_order_relaxed) & bit) [[unlikely]]
+	word.fetch_and(~bit, std::memory_order_relaxed);
+    };
+
+    inline bool isAsleep(uint64_t id) {
+      return asleepBits[id / 64].load(std::memory_order_relaxed) & (uint64_t(1) << (id % 64));
+    };
+
+    //applies this frame's wakes over any sleep that landed after them, then wakes objects whose timed sleep ends on or before the given frame. Concurrency never allowed, call between frames.
+    void wakeThrough(uint64_t frame) {
+      const uint64_t words = liveBits.size();
+      for(uint64_t i = 0;i < words;i++) {
+	const uint64_t woken = wokenBits[i].exchange(0, std::memory_order_relaxed);
+	if(woken) [[unlikely]]
+	  asleepBits[i].fetch_and(~woken, std::memory_order_relaxed);
+      }
+      scopeLock l(&sleepMutex);
+      auto end = wakeups.upper_bound(frame);
+      for(auto it = wakeups.begin();it != end;it++) {
+	auto su = sleepUntil.find(it->second);
+	if(su != sleepUntil.end() && su->second == it->first) {
+	  //not wake(): that would be recorded against the next frame
+	  asleepBits[it->second / 64].fetch_and(~(uint64_t(1) << (it->second % 64)), std::memory_order_relaxed);
+	  sleepUntil.erase(su);
+	}
+      }
+      wakeups.erase(wakeups.begin(), end);
+    };
+
+    //objects allocated this frame become visible to forEachLive. Concurrency never allowed, call between frames.
+    void commitFrame() {
+      const uint64_t words = liveBits.size();
+      for(uint64_t i = 0;i < words;i++) {
+	uint64_t born = bornBits[i].exchange(0, std::memory_order_relaxed);
+	if(born) [[unlikely]]
+	  liveBits[i].fetch_or(born, std::memory_order_relaxed);
+      }
+    };
+
+    //number of objects that exist as of the current frame, including those allocated this frame but not those pending delete. Only a snapshot if anything is allocating or freeing.
+    uint64_t liveCount() {
+      uint64_t ret = 0;
+      const uint64_t words = liveBits.size();
+      for(uint64_t i = 0;i < words;i++)
+	ret += std::popcount(liveBits[i].load(std::memory_order_relaxed) | bornBits[i].load(std::memory_order_relaxed));
+      return ret;
+    };
+
+    //number of words to divide among forEachLive calls
+    inline uint64_t liveWords() {
+      return liveBits.size();
+    };
+
+    //calls cb(id) for each live (and if awakeOnly, not sleeping) object with id in [beginWord*64, endWord*64). Objects freed before the scan reaches them are skipped, objects allocated this frame are not visited.
+    //concurrency allowed with everything but commitFrame
+    template<bool awakeOnly, class L> void forEachLive(uint64_t beginWord, uint64_t endWord, L cb) {
+      for(uint64_t i = beginWord;i < endWord;i++) {
+	uint64_t bits = liveBits[i].load(std::memory_order_relaxed);
+	if constexpr(awakeOnly)
+	  bits &= ~asleepBits[i].load(std::memory_order_relaxed);
+	while(bits) {
+	  const uint64_t b = std::countr_zero(bits);
+	  cb(i * 64 + b);
+	  //reload because cb may have freed (or put to sleep) another object in this word
+	  bits = liveBits[i].load(std::memory_order_relaxed) & ~((uint64_t(2) << b) - 1);
+	  if constexpr(awakeOnly)
+	    bits &= ~asleepBits[i].load(std::memory_order_relaxed);
+	}
+      }
     };
 
     //reads the state of the requested object as of the requested frame, if possible, or otherwise, the oldest known state
     //returns true if the object exists at the time the chosen state was correct, or false to indicate out was unchanged
+    //objects created after the requested frame do not exist as of that frame
     //concurrency allowed with everything but `applyLogs`
     bool load(uint64_t id, uint64_t frame, R* out) {
       const D& master = masterDataFile.deref(id);
       if(master.lastDeletedFrame > master.lastCreatedFrame) [[unlikely]]
 	return false; //this case only covers the case when the delete log has been applied
+      if(master.lastCreatedFrame > frame) [[unlikely]]
+	return false; //did not exist yet at the requested frame
       //start from firstLog so a concurrent write (which will alter lastLog) does not interfere
       //if the concurrent write alters firstLog, it is changing it from NONE to the id of a log which is already valid
       L* tl = logDataFile.get(masterDataFile.deref(id).firstLog);
@@ -210,10 +420,21 @@ namespace WITE {
       write(id, frame, in);
     };
 
+    //a log is counted as applied when it is retired, because the last log may be applied more than once in pipelined mode
+    inline void retireLog(uint64_t id, bool pipelined) {
+      const size_t shard = ldf_t::shardOf(id);
+      myCounters().logsApplied.fetch_add(1, std::memory_order_relaxed);
+      if(pipelined)
+	quarantinedLogs[shard].push_back(id);
+      else
+	logDataFile.free(id);
+    };
+
     //applies all logs to the given object up to and including any associated with the given frame
     //NOTE: applying a delete log frees the object, which invalidates any iterators pointing at it
-    //concurrency never allowed. Game loop should not allow log application to overlap with other game logic
-    void applyLogs(uint64_t id, uint64_t throughFrame) {
+    //if not pipelined: concurrency never allowed. Game loop should not allow log application to overlap with other game logic
+    //if pipelined: concurrency allowed with load and store of frames after throughFrame (and with allocate), but not with other calls to applyLogs or with releaseQuarantine. Retired ids are quarantined, and the last log is never removed (only copied into master) so that concurrent writers, which only touch the last log, never race with this.
+    void applyLogs(uint64_t id, uint64_t throughFrame, bool pipelined = false) {
       WITE_DEBUG_DB_MASTER(id);
       D& master = masterDataFile.deref(id);
       //every log has a complete copy of the data portion so we only need to apply the last and free the ones before it
@@ -228,52 +449,257 @@ namespace WITE {
 	WITE_DEBUG_DB_LOG(tlid);
 	tl = nl;
 	nl = logDataFile.get(tl->nextLog);
-	logDataFile.free(oldtlid);
+	retireLog(oldtlid, pipelined);
       }
       //if there is a delete log, it will be the last one
       switch(tl->type) {
       case eLogType::eDelete:
-	//freeing immediately now so it doesn't get updates, and can be re-allocated even before it's flushed
-	// ASSERT_TRAP(tl->nextLog == NONE, "delete is not the last log for that object");
-	// masterDataFile.free(id);
+	//the row stopped getting updates when it was freed, now that no frame that can still be read has it, it can be reused
+	master.firstLog = master.lastLog = NONE;
+	master.lastDeletedFrame = tl->frame;
+	retireLog(tlid, pipelined);
+	if(pipelined)
+	  quarantinedRows[mdf_t::shardOf(id)].push_back(id);
+	else
+	  masterDataFile.free(id);
 	break;
       case eLogType::eUpdate: [[likely]]
 	memcpy(master.data, tl->data);
-	master.firstLog = tl->nextLog;//might be NONE
 	master.lastLogAppliedFrame = tl->frame;
+	if(pipelined && !nl) {
+	  //keep the last log, so firstLog and lastLog are left alone. Readers only read master data when there are no logs.
+	  master.firstLog = tlid;
+	  tl->previousLog = NONE;
+	  break;
+	}
+	master.firstLog = tl->nextLog;//might be NONE
 	if(nl) [[likely]]
 	  nl->previousLog = NONE;
 	else
 	  master.lastLog = NONE;
+	retireLog(tlid, pipelined);
 	break;
       }
-      logDataFile.free(tlid);
       WITE_DEBUG_DB_MASTER(id);
     };
 
-    void applyLogsAll(uint64_t throughFrame) {
-      auto it = begin();
-      auto e = end();
+    //applyLogs for every row in one shard. Different shards may be applied concurrently, under the same rules as applyLogs.
+    void applyLogsShard(size_t shard, uint64_t throughFrame, bool pipelined = false) {
+      auto& s = masterDataFile.shard(shard);
+      auto it = s.begin();
+      auto e = s.end();
       while(it != e) {
-	applyLogs(*it++, throughFrame);//prefix increment: the iterator must be incremented before applyLogs is called so it doesn't get invalidated by a delete log
+	applyLogs(mdf_t::globalOf(shard, *it++), throughFrame, pipelined);//prefix increment: the iterator must be incremented before applyLogs is called so it doesn't get invalidated by a delete log
+      }
+    };
+
+    void applyLogsAll(uint64_t throughFrame, bool pipelined = false) {
+      for(size_t i = 0;i < SHARDS;i++)
+	applyLogsShard(i, throughFrame, pipelined);
+    };
+
+    //frees everything retired by pipelined log application. Concurrency never allowed, call between frames.
+    void releaseQuarantine() {
+      for(size_t i = 0;i < SHARDS;i++) {
+	for(uint64_t id : quarantinedLogs[i])
+	  logDataFile.free(id);
+	quarantinedLogs[i].clear();
+	for(uint64_t id : quarantinedRows[i])
+	  masterDataFile.free(id);
+	quarantinedRows[i].clear();
+      }
+    };
+
+    inline void countUpdates(uint64_t cnt) {
+      myCounters().updates.fetch_add(cnt, std::memory_order_relaxed);
+    };
+
+    inline void timeUpdateRange(uint64_t ns) {
+      updateChunking.record(ns);
+    };
+
+    //how many update ranges per pool thread to split this frame into
+    inline uint64_t updateChunksPerThread() {
+      return updateChunking.next();
+    };
+
+    //totals over all stripes
+    dbTableFrameStats getCounters() {
+      dbTableFrameStats ret {};
+      for(const counterStripe_t& c : counters) {
+	ret.updates += c.updates.load(std::memory_order_relaxed);
+	ret.logsWritten += c.logsWritten.load(std::memory_order_relaxed);
+	ret.logsApplied += c.logsApplied.load(std::memory_order_relaxed);
+	ret.allocations += c.allocations.load(std::memory_order_relaxed);
+	ret.frees += c.frees.load(std::memory_order_relaxed);
+      }
+      return ret;
+    };
+
+    inline const std::string& getFileId() {
+      return typeId;
+    };
+
+    //only rows changed after this is called are published. Concurrency never allowed, call between frames.
+    void setTrackChanges(bool track) {
+      trackChanges = track;
+    };
+
+    //publishes every object created, written or destroyed in the given frame, which must be the frame that just ended, in id order
+    //an object created and destroyed in the same frame is not published. Concurrency never allowed, call between frames.
+    void publishChanges(uint64_t frame, dbChangeFeed& feed) {
+      const uint64_t words = changedBits.size();
+      for(uint64_t w = 0;w < words;w++) {
+	uint64_t bits = changedBits[w].load(std::memory_order_relaxed);
+	if(!bits) [[likely]] continue;
+	changedBits[w].store(0, std::memory_order_relaxed);
+	while(bits) {
+	  const uint64_t id = w * 64 + std::countr_zero(bits);
+	  bits &= bits - 1;
+	  const bool created = masterDataFile.deref(id).lastCreatedFrame == frame;
+	  R data;
+	  if(load(id, frame, &data)) {
+	    feed.append(R::typeId, id, frame, created ? dbChangeFeed::op_e::eCreate : dbChangeFeed::op_e::eUpdate, &data, sizeof(R));
+	  } else if(!created) {
+	    feed.append(R::typeId, id, frame, dbChangeFeed::op_e::eDelete, NULL, 0);
+	  }
+	}
+      }
+    };
+
+    //starts a backup of the state as of the given frame, which must be the frame that just ended. Nothing is read until writeBackup.
+    //previousFrame is the frame of the previous backup, of which this is an increment: only the objects created, written or destroyed since then are included. NONE for a full backup of every object.
+    //concurrency never allowed, call between frames
+    void beginBackup(const std::filesystem::path& outdir, uint64_t frame, uint64_t previousFrame) {
+      ASSERT_TRAP(backupFrame == NONE, "backup already pending");
+      const uint64_t words = liveBits.size();
+      backupRows.resize(words);
+      for(uint64_t i = 0;i < words;i++) {
+	backupRows[i] = dirtyBits[i].exchange(0, std::memory_order_relaxed);
+	if(previousFrame == NONE)
+	  backupRows[i] |= liveBits[i].load(std::memory_order_relaxed);
+      }
+      backupFilename = backupFilenameFor(outdir, typeId, frame);
+      backupFrame = frame;
+      backupPreviousFrame = previousFrame;
+    };
+
+    //true if a pending backup must be written before logs can be applied through the given frame
+    inline bool backupDue(uint64_t throughFrame) {
+      return backupFrame != NONE && throughFrame >= backupFrame;
+    };
+
+    //writes the pending backup. Must be called before any logs after the backup's frame are applied. Concurrency: same as applyLogs, the caller should be the one applying logs.
+    //this is the only part of a backup that touches the rows, so the cost is proportional to the number of rows in the backup, and log application is never held up by an earlier backup
+    //the file is written under a temporary name and renamed when complete, so a reader (like a dbReplica tailing the backups) never sees a partial file
+    void writeBackup() {
+      std::filesystem::path tempFilename = backupFilename;
+      tempFilename += ".tmp";
+      std::ofstream out(tempFilename, std::ios::binary | std::ios::trunc);
+      ASSERT_TRAP(out, "could not open backup file ", tempFilename);
+      backupHeader_t h { backupMagic, sizeof(R), backupFrame, backupPreviousFrame };
+      out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      backupRecord_t r;
+      for(uint64_t i = 0;i < backupRows.size();i++) {
+	uint64_t bits = backupRows[i];
+	while(bits) {
+	  const uint64_t b = std::countr_zero(bits);
+	  bits &= bits - 1;
+	  r.id = i * 64 + b;
+	  if(load(r.id, backupFrame, reinterpret_cast<R*>(&r.data)))
+	    r.createdFrame = masterDataFile.deref(r.id).lastCreatedFrame;
+	  else if(backupPreviousFrame == NONE)
+	    continue;//a full backup only lists objects that exist
+	  else
+	    r.createdFrame = NONE;
+	  out.write(reinterpret_cast<const char*>(&r), sizeof(r));
+	}
       }
+      out.close();
+      ASSERT_TRAP(out, "failed to write backup file ", tempFilename);
+      std::error_code ec;
+      std::filesystem::rename(tempFilename, backupFilename, ec);
+      ASSERT_TRAP(!ec, "failed to rename backup file ", backupFilename, ec);
+      backupFrame = NONE;
+      backupRows.clear();
     };
 
-    void copyMdf(const std::filesystem::path& outdir) {
-      std::filesystem::path outfile = outdir / concat({ "backup_", typeId, ".wdb" });
-      masterDataFile.copy(outfile);
+    //rebuilds the master file for this type in basedir from the backups in backupDir: the newest full backup at or before throughFrame, then each increment that follows it in sequence.
+    //any existing master and log files for this type in basedir are replaced. Must not be called while this type is open in basedir.
+    //returns the frame the table was restored to, or NONE if there was no usable full backup
+    static uint64_t restore(const std::filesystem::path& backupDir, const std::filesystem::path& basedir, const std::string& typeId, uint64_t throughFrame = NONE) {
+      const std::string prefix = concat({ "backup_", typeId, "_" });
+      std::map<uint64_t, std::pair<backupHeader_t, std::filesystem::path>> backups;//by frame
+      for(const auto& entry : std::filesystem::directory_iterator(backupDir)) {
+	const std::string name = entry.path().stem().string();
+	if(entry.path().extension() != ".wdb" || !name.starts_with(prefix) || name.size() == prefix.size() ||
+	   name.find_first_not_of("0123456789", prefix.size()) != std::string::npos)
+	  continue;
+	std::ifstream in(entry.path(), std::ios::binary);
+	backupHeader_t h;
+	if(!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || h.magic != backupMagic || h.rowSize != sizeof(R)) [[unlikely]] {
+	  WARN("ignoring invalid backup file ", entry.path());
+	  continue;
+	}
+	if(h.frame <= throughFrame)
+	  backups.emplace(h.frame, std::pair(h, entry.path()));
+      }
+      auto base = backups.rbegin();
+      while(base != backups.rend() && base->second.first.previousFrame != NONE)
+	base++;
+      if(base == backups.rend()) [[unlikely]]
+	return NONE;
+      std::map<uint64_t, backupRecord_t> rows;
+      uint64_t frame = base->first;
+      for(auto it = std::prev(base.base());it != backups.end();it++) {
+	if(it->second.first.previousFrame != (it->first == frame ? NONE : frame)) [[unlikely]] {
+	  WARN("backup sequence for ", typeId, " broken at frame ", it->first, ", restoring to frame ", frame);
+	  break;
+	}
+	frame = it->first;
+	std::ifstream in(it->second.second, std::ios::binary);
+	in.seekg(sizeof(backupHeader_t));
+	backupRecord_t r;
+	while(in.read(reinterpret_cast<char*>(&r), sizeof(r))) {
+	  if(r.createdFrame == NONE)
+	    rows.erase(r.id);
+	  else
+	    rows[r.id] = r;
+	}
+      }
+      ldf_t::removeFiles(logFilenameFor(basedir, typeId));
+      masterFile_t mdf(masterFilenameFor(basedir, typeId), true);
+      for(auto it = rows.rbegin();it != rows.rend();it++) {
+	mdf.allocateSpecific(it->first);
+	D& master = mdf.deref(it->first);
+	master.firstLog = master.lastLog = NONE;
+	master.lastDeletedFrame = 0;
+	master.lastCreatedFrame = it->second.createdFrame;
+	master.lastLogAppliedFrame = frame;
+	memcpy(master.data, it->second.data);
+      }
+      //rows that are not restored read as destroyed, like freed rows in the original
+      for(uint64_t id = 0;id < mdf.capacity();id++) {
+	D* m = mdf.find_unsafe(id);
+	if(!m || rows.contains(id)) continue;//not every id below capacity is backed when sharded
+	D& master = *m;
+	master.firstLog = master.lastLog = NONE;
+	master.lastCreatedFrame = 0;
+	master.lastDeletedFrame = frame;
+      }
+      return frame;
     };
 
     void deleteFiles() {
       logDataFile.close();
       masterDataFile.close();
-      std::filesystem::remove(mdfFilename);
-      std::filesystem::remove(ldfFilename);
+      mdf_t::removeFiles(mdfFilename);
+      ldf_t::removeFiles(ldfFilename);
     };
 
     void deleteLogs() {
       logDataFile.close();
-      std::filesystem::remove(ldfFilename);
+      ldf_t::removeFiles(ldfFilename);
     };
 
     inline auto begin() {
@@ -289,7 +715,7 @@ namespace WITE {
     };
 
     inline uint64_t size() {
-      return capacity() - masterDataFile.freeSpace();
+      return masterDataFile.size();
     };
 
     uint64_t maxFrame() {
@@ -40,7 +40,7 @@ namespace WITE {
       rest(basedir, clobberMaster, clobberLog),
       indices(basedir, clobberLog)
     {
-      ASSERT_TRAP(clobberMaster || !clobberLog, "illegal argument: clobber master but keep log");
+      ASSERT_TRAP(clobberLog || !clobberMaster, "illegal argument: clobber master but keep log");
     };
 
     template<uint64_t ID> inline auto& get() {
@@ -16,6 +16,8 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #include <type_traits>
 #include <concepts>
+#include <tuple>
+#include <atomic>
 
 #include "threadPool.hpp"
 
@@ -41,19 +43,101 @@ namespace WITE {
   template<class T> requires requires(uint64_t oid, void* db) { {T::spunDown(oid, db)} -> std::same_as<void>; }
   struct has_spunDown<T> : public std::true_type {};
 
+  //update scheduling: types are updated in phases, with a barrier between consecutive phases and none within a phase
+  //phase is the greater of the optional `static constexpr uint32_t updatePhase` and one more than the phase of each type in the optional `typedef std::tuple<...> updateAfter`
+  template<class T> struct dbUpdatePhaseBaseOf : public std::integral_constant<uint32_t, 0> {};
+  template<class T> requires requires() { {T::updatePhase} -> std::convertible_to<uint32_t>; }
+  struct dbUpdatePhaseBaseOf<T> : public std::integral_constant<uint32_t, T::updatePhase> {};
+
+  template<class T> struct dbUpdatePhaseOf;
+
+  template<class... A> constexpr uint32_t dbUpdatePhaseAfter(std::tuple<A...>*) {
+    uint32_t ret = 0;
+    ((ret = max(ret, dbUpdatePhaseOf<A>::value + 1)), ...);
+    return ret;
+  };
+
+  template<class T> struct dbUpdatePhaseOf : public std::integral_constant<uint32_t, dbUpdatePhaseBaseOf<T>::value> {};
+  template<class T> requires requires() { typename T::updateAfter; }
+  struct dbUpdatePhaseOf<T> : public std::integral_constant<uint32_t, max(dbUpdatePhaseBaseOf<T>::value,
+									  dbUpdatePhaseAfter(static_cast<typename T::updateAfter*>(NULL)))> {};
+
+  //within a phase, types with higher `static constexpr int32_t updatePriority` are submitted first (default 0, ties in declaration order)
+  template<class T> struct dbUpdatePriorityOf : public std::integral_constant<int32_t, 0> {};
+  template<class T> requires requires() { {T::updatePriority} -> std::convertible_to<int32_t>; }
+  struct dbUpdatePriorityOf<T> : public std::integral_constant<int32_t, T::updatePriority> {};
+
   //so we don't have to malloc up a new callbackPtr for every object being updated, reuse the callback object and store the oid in jobData
+  //database jobs are frame work unless a lane is given
   template<class T, void(*F)(uint64_t, void*)> struct dbJobWrapper {
     static void cb(threadPool::jobData_t& jd) { F(jd[0], reinterpret_cast<void*>(jd[1])); };
     static_assert(sizeof(void*) <= sizeof(uint64_t));
     static constexpr threadPool::jobEntry_t_F::StaticCallback<> cbt = &cb;
     static constexpr threadPool::jobEntry_t_ce cbce = &cbt;
+    static inline threadPool::job_t job(uint64_t oid, void* db, threadPool::lane_e lane = threadPool::lane_e::eFrameCritical) {//for then()
+      return { threadPool::jobEntry_t(cbce), { oid, reinterpret_cast<uint64_t>(db) }, lane };
+    };
     threadPool::job_t j;
-    dbJobWrapper(uint64_t oid, void* db, threadPool& tp) :
-      j({ threadPool::jobEntry_t(cbce), { oid, reinterpret_cast<uint64_t>(db) } }) {
-      tp.submitJob(&j);
+    dbJobWrapper(uint64_t oid, void* db, threadPool& tp, threadPool::counter_t* counter = NULL,
+		 threadPool::lane_e lane = threadPool::lane_e::eFrameCritical) : j(job(oid, db, lane)) {
+      tp.submitJob(&j, counter);
     };
   };
 
+  //for batch work that is split into ranges (of ids or of positions in some list): F(begin, end, db)
+  template<void(*F)(uint64_t, uint64_t, void*)> struct dbRangeJobWrapper {
+    static void cb(threadPool::jobData_t& jd) { F(jd[0], jd[1], reinterpret_cast<void*>(jd[2])); };
+    static constexpr threadPool::jobEntry_t_F::StaticCallback<> cbt = &cb;
+    static constexpr threadPool::jobEntry_t_ce cbce = &cbt;
+    threadPool::job_t j;
+    dbRangeJobWrapper(uint64_t begin, uint64_t end, void* db, threadPool& tp, threadPool::counter_t* counter = NULL,
+		      threadPool::lane_e lane = threadPool::lane_e::eFrameCritical) :
+      j({ threadPool::jobEntry_t(cbce), { begin, end, reinterpret_cast<uint64_t>(db) }, lane }) {
+      tp.submitJob(&j, counter);
+    };
+  };
+
+  //how finely to split one table's update ranges, adjusted each frame from how long the previous frame's ranges took
+  struct dbChunkTuning {
+    static constexpr uint64_t minChunksPerThread = 1, maxChunksPerThread = 64,
+      minRangeNs = 20000;//below this per range, dispatch is a noticeable share of the work
+    uint64_t chunksPerThread = 8;//only touched by the thread submitting the updates
+    std::atomic_uint64_t ranges, totalNs, worstNs;
+
+    inline void record(uint64_t ns) {
+      ranges.fetch_add(1, std::memory_order_relaxed);
+      totalNs.fetch_add(ns, std::memory_order_relaxed);
+      uint64_t worst = worstNs.load(std::memory_order_relaxed);
+      while(worst < ns && !worstNs.compare_exchange_weak(worst, ns, std::memory_order_relaxed));
+    };
+
+    //called before submitting a frame's ranges, after the previous frame's have all finished
+    uint64_t next() {
+      const uint64_t n = ranges.exchange(0, std::memory_order_relaxed),
+	total = totalNs.exchange(0, std::memory_order_relaxed),
+	worst = worstNs.exchange(0, std::memory_order_relaxed);
+      if(!n) [[unlikely]] return chunksPerThread;
+      const uint64_t mean = total / n;
+      if(mean < minRangeNs) {
+	if(chunksPerThread > minChunksPerThread)
+	  chunksPerThread /= 2;
+      } else if(worst > 2 * mean && chunksPerThread < maxChunksPerThread) {
+	chunksPerThread *= 2;//a few ranges held the frame up, so split finer and let idle threads take their neighbours
+      }
+      return chunksPerThread;
+    };
+  };
+
+  //always available, cumulative since the table was opened. Relaxed atomics, striped across threads by dbTable, so they are cheap enough to leave on in production.
+  struct dbTableCounters {
+    std::atomic_uint64_t updates, logsWritten, logsApplied, allocations, frees;
+  };
+
+  //one table's share of database::frameStats, as differences of dbTableCounters between frames
+  struct dbTableFrameStats {
+    uint64_t updates, logsWritten, logsApplied, allocations, frees;
+  };
+
   //shoot for 64kb page
   template<class T> struct dbAllocationBatchSizeOf : public std::integral_constant<size_t, 65536/sizeof(T)+1> {};
   template<class T> requires requires() { {T::dbAllocationBatchSize}; }
@@ -63,6 +147,11 @@ namespace WITE {
   template<class T> requires requires() { {T::dbLogAllocationBatchSize}; }
   struct dbLogAllocationBatchSizeOf<T> : public std::integral_constant<size_t, T::dbLogAllocationBatchSize> {};
 
+  //number of files each of the type's master and log are split across. Allocation and log application are per shard, so more shards means less contention for busy types.
+  template<class T> struct dbShardCountOf : public std::integral_constant<size_t, 1> {};
+  template<class T> requires requires() { {T::dbShardCount}; }
+  struct dbShardCountOf<T> : public std::integral_constant<size_t, T::dbShardCount> {};
+
   struct db_singleton {//extend in classes that are meant to be of singular or limited quantity
     static constexpr size_t dbAllocationBatchSize = 1, dbLogAllocationBatchSize = 1;
   };
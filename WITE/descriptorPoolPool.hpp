@@ -15,11 +15,12 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #pragma once
 
 #include <vector>
-#include <queue>
 
 #include "wite_vulkan.hpp"
 #include "literalList.hpp"
 #include "gpu.hpp"
+#include "syncLock.hpp"
+#include "boundedQueue.hpp"
 
 namespace WITE {
 
@@ -41,7 +42,8 @@ namespace WITE {
       };
     };
     static constexpr auto RCS = where<resourceConsumer, allRCS, isDescriptor>();
-    static constexpr uint32_t batchSize = 256;
+    static constexpr uint32_t batchSize = 256, maxAvailable = 4096;
+    static_assert(maxAvailable >= batchSize);
     static constexpr copyableArray<vk::DescriptorSetLayoutBinding, RCS.LENGTH> bindings = [](size_t i) {
       return vk::DescriptorSetLayoutBinding { uint32_t(i), RCS[i].usage.asDescriptor.descriptorType, 1, RCS[i].stages };
     };
@@ -54,10 +56,12 @@ namespace WITE {
   private:
     gpu& dev;
     vk::DescriptorSetLayout layoutStaging[batchSize];//N copies of the same layout
+    syncLock growMutex { "descriptorPoolPool::growMutex" };//guards everything below it, only taken when available runs dry or overflows
     vk::DescriptorSet setsStaging[batchSize];
     vk::DescriptorSetAllocateInfo allocInfo;
     std::vector<vk::DescriptorPool> pools;
-    std::queue<vk::DescriptorSet> available;
+    mpmcQueue<vk::DescriptorSet, maxAvailable> available;
+    std::vector<vk::DescriptorSet> overflow;//free sets that didn't fit in available, used before growing
 
   public:
     descriptorPoolPool() : dev(gpu::get(GPUID)) {
@@ -76,20 +80,25 @@ namespace WITE {
     virtual vk::DescriptorSet allocate() override {
       if constexpr(RCS.LENGTH) {
 	vk::DescriptorSet ret;
-	if(available.size()) {
-	  ret = available.front();
-	  available.pop();
-	} else {
-	  vk::DescriptorPool newPool;
-	  VK_ASSERT(dev.getVkDevice().createDescriptorPool(&dpci, ALLOCCB, &newPool), "failed to create descriptor set pool");
-	  pools.push_back(newPool);
-	  allocInfo.setDescriptorPool(newPool);
-	  VK_ASSERT(dev.getVkDevice().allocateDescriptorSets(&allocInfo, setsStaging), "failed to empty pool");
-	  ret = setsStaging[0];
-	  for(size_t i = 1;i < batchSize;i++)
-	    available.push(setsStaging[i]);
+	if(available.pop(ret)) [[likely]]
+	  return ret;
+	scopeLock lock(&growMutex);
+	if(available.pop(ret))//someone else grew it while we waited
+	  return ret;
+	if(overflow.size()) {
+	  ret = overflow.back();
+	  overflow.pop_back();
+	  return ret;
 	}
-	return ret;
+	vk::DescriptorPool newPool;
+	VK_ASSERT(dev.getVkDevice().createDescriptorPool(&dpci, ALLOCCB, &newPool), "failed to create descriptor set pool");
+	pools.push_back(newPool);
+	allocInfo.setDescriptorPool(newPool);
+	VK_ASSERT(dev.getVkDevice().allocateDescriptorSets(&allocInfo, setsStaging), "failed to empty pool");
+	for(size_t i = 1;i < batchSize;i++)
+	  if(!available.push(setsStaging[i])) [[unlikely]]
+	    overflow.push_back(setsStaging[i]);//only if frees filled it meanwhile
+	return setsStaging[0];
       } else {
 	return VK_NULL_HANDLE;
       }
@@ -97,7 +106,10 @@ namespace WITE {
 
     virtual void free(vk::DescriptorSet f) override {
       if constexpr(RCS.LENGTH) {
-	available.push(f);
+	if(!available.push(f)) [[unlikely]] {
+	  scopeLock lock(&growMutex);
+	  overflow.push_back(f);
+	}
       }
     };
 
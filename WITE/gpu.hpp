@@ -70,7 +70,8 @@ namespace WITE {
     std::map<hash_t, vk::Sampler> samplers;
     std::map<hash_t, vk::DescriptorSetLayout> descriptorSetLayouts;
     std::map<hash_t, vk::PipelineLayout> pipelineLayouts;
-    syncLock samplersMutex, descriptorSetLayoutsMutex, pipelineLayoutsMutex, queueMutex, lowPrioQueueMutex;
+    syncLock samplersMutex { "gpu::samplersMutex" }, descriptorSetLayoutsMutex { "gpu::descriptorSetLayoutsMutex" }, pipelineLayoutsMutex { "gpu::pipelineLayoutsMutex" },
+      queueMutex { "gpu::queueMutex" }, lowPrioQueueMutex { "gpu::lowPrioQueueMutex" };
     threadResource<cmdPool> tempCmds;
 
     gpu(size_t idx, vk::PhysicalDevice, int deviceExtensionsCount, const char** deviceExtensions);
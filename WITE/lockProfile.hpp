@@ -0,0 +1,39 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+//lock contention profiling, opt in with -DWITE_LOCK_PROFILE. Locks constructed with a site name count their acquisitions, contended acquisitions, wait and hold time against that name. printProfileData reports them.
+//when disabled, names are dropped by the constructors and no lock carries any extra state.
+
+namespace WITE {
+
+  //one per name, shared by every lock constructed with it, so (for example) each table's rowLocks_mutex adds up to one line
+  struct lockSite {
+    struct counts_t {
+      std::atomic_uint64_t acquisitions, contended, waitNs, maxWaitNs, holdNs, maxHoldNs;
+    };
+    const char* name = NULL;
+    counts_t exclusive, shared;//shared is only used by concurrentReadSyncLock's reads
+    static lockSite* get(const char* name);//NULL for NULL. Names are compared by content, and must outlive the program (literals).
+    static uint64_t now();
+    //returns now, to be passed to released when the hold ends
+    static uint64_t acquired(counts_t& c, uint64_t waitStart, bool contended);
+    static void released(counts_t& c, uint64_t heldSince);
+  };
+
+}
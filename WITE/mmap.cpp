@@ -31,10 +31,21 @@ namespace WITE {
     return ret;
   };
 
+  fileHandle openFileReadOnly(const std::filesystem::path& filename) {
+    fileHandle ret = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+				 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    ASSERT_TRAP(ret != INVALID_HANDLE_VALUE, "failed to open file ", filename, " with error: ", GetLastError());
+    return ret;
+  };
+
   bool lockFile(fileHandle fd) {
     return true;//no-op bc windows files are locked on openFile bc shareMode = 0
   };
 
+  bool lockFileShared(fileHandle fd) {
+    return true;//no-op bc openFileReadOnly only shares with other readers
+  };
+
   bool unlockFile(fileHandle fd) {
     return true;
   };
@@ -66,6 +77,15 @@ namespace WITE {
     return ret;
   };
 
+  void* mmapFileReadOnly(fileHandle fd, size_t start, size_t length) {
+    HANDLE mapping = CreateFileMappingA(fd, NULL, PAGE_READONLY, static_cast<DWORD>(length >> 32), static_cast<DWORD>(length),
+					NULL);
+    ASSERT_TRAP(mapping, "failed to create file mapping ", GetLastError());
+    void* ret = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(start >> 32), static_cast<DWORD>(start), length);
+    ASSERT_TRAP(ret, "failed to create view map of file");
+    return ret;
+  };
+
   void closeMmapFile(void* addr, size_t length) {
     FlushViewOfFile(addr, length);
     UnmapViewOfFile(addr);
@@ -94,12 +114,18 @@ namespace WITE {
     return fd;
   };
 
-  bool lockFile(fileHandle fd) {
+  fileHandle openFileReadOnly(const std::filesystem::path& filename) {
+    fileHandle fd = ::open(filename.c_str(), O_RDONLY | O_NOFOLLOW | O_LARGEFILE);
+    ASSERT_TRAP(fd > 0, "failed to open file ", filename, " with errno: ", errno);
+    return fd;
+  };
+
+  bool flockRetry(fileHandle fd, int op) {
     uint32_t sleepCnt = 0;
     int e;
     bool ret;
     do {
-      ret = ::flock(fd, LOCK_EX | LOCK_NB) == 0;
+      ret = ::flock(fd, op | LOCK_NB) == 0;
       e = errno;
       thread::sleepShort(sleepCnt);//escalating wait time, no wait on first pass
     } while(!ret && e == EAGAIN && sleepCnt < 1000);
@@ -107,6 +133,14 @@ namespace WITE {
     return ret;
   };
 
+  bool lockFile(fileHandle fd) {
+    return flockRetry(fd, LOCK_EX);
+  };
+
+  bool lockFileShared(fileHandle fd) {
+    return flockRetry(fd, LOCK_SH);
+  };
+
   bool unlockFile(fileHandle fd) {
     int ret = ::flock(fd, LOCK_UN) == 0;
     bool e = errno;
@@ -137,6 +171,16 @@ namespace WITE {
     return ret;
   };
 
+  void* mmapFileReadOnly(fileHandle fd, size_t start, size_t length) {
+    ASSERT_TRAP(length, "attempted to mmap empty region");
+    void* ret = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, start);
+    #ifdef DEBUG
+    auto en = errno;
+    #endif
+    ASSERT_TRAP(ret && ret != MAP_FAILED, "mmap fail ", en, " fd: ", fd, " start: ", start, " length: ", length);
+    return ret;
+  };
+
   void closeMmapFile(void* addr, size_t length) {
     ::msync(addr, length, MS_SYNC);
     //freeing is not needed on unix, the fd closure will handle that
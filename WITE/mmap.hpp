@@ -29,8 +29,14 @@ namespace WITE {
   //asserts success, if a crash on failure is not desired, potential failure conditions must first be checked using c++ interface
   fileHandle openFile(const std::filesystem::path&, bool writable, bool clobber);
 
+  //for readers of files that some other process might have open. Fails (asserts) if the file does not exist.
+  fileHandle openFileReadOnly(const std::filesystem::path&);
+
   bool lockFile(fileHandle fd);
 
+  //shared with other shared locks, blocks (within reason) on exclusive locks
+  bool lockFileShared(fileHandle fd);
+
   bool unlockFile(fileHandle fd);
 
   //seekFileEnd + writeFile = append
@@ -43,6 +49,9 @@ namespace WITE {
 
   void* mmapFile(fileHandle fd, size_t start, size_t length);
 
+  //writing to the returned region is a segfault
+  void* mmapFileReadOnly(fileHandle fd, size_t start, size_t length);
+
   void closeMmapFile(void*, size_t length);
 
   void closeFile(fileHandle);
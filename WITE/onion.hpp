@@ -59,7 +59,7 @@ namespace WITE {
     static constexpr size_t layerIdx_OPTE = OD.LRS.len-1;
 
     uint64_t frame = 1;//can't signal a timeline semaphore with 0
-    syncLock mutex;
+    syncLock mutex { "onion::mutex" };
     vk::CommandPool cmdPool;
     gpu* dev;
     vk::CommandBuffer primaryCmds[cmdFrameswapCount];
@@ -16,7 +16,7 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 namespace WITE {
 
-  syncLock onionStaticData::allDataMutex;
+  syncLock onionStaticData::allDataMutex { "onionStaticData::allDataMutex" };
   std::map<hash_t, onionStaticData> onionStaticData::allOnionData;//static
 
 };
@@ -15,8 +15,12 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include <memory>
 #include <chrono>
 #include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
 
 #include "profiler.hpp"
+#include "lockProfile.hpp"
 #include "DEBUG.hpp"
 #include "stdExtensions.hpp"
 
@@ -27,6 +31,79 @@ namespace WITE {
   std::mutex profiler::allProfiles_mutex;
   std::atomic_uint64_t profiler::allProfilesMutexTime;
   std::atomic_uint64_t profiler::allProfilesExecutions;
+  std::map<const void*, std::function<void(std::ostream&)>> profiler::statsSources;
+
+  //function statics, because locks with static storage may be named before this file's statics are constructed. Never freed, so they can still be released after this file's statics are destroyed.
+  static std::mutex& lockSitesMutex() {
+    static std::mutex* ret = new std::mutex();
+    return *ret;
+  };
+
+  static std::map<std::string, lockSite>& lockSites() {
+    static std::map<std::string, lockSite>* ret = new std::map<std::string, lockSite>();
+    return *ret;
+  };
+
+  lockSite* lockSite::get(const char* name) { //static
+    if(!name) return NULL;
+    std::lock_guard<std::mutex> lock(lockSitesMutex());
+    auto pair = lockSites().try_emplace(name);
+    lockSite* ret = &pair.first->second;
+    if(pair.second)
+      ret->name = pair.first->first.c_str();
+    return ret;
+  };
+
+  uint64_t lockSite::now() { //static
+    return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()).time_since_epoch().count();
+  };
+
+  uint64_t lockSite::acquired(counts_t& c, uint64_t waitStart, bool contended) { //static
+    const uint64_t ret = now();
+    c.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if(contended) {
+      c.contended.fetch_add(1, std::memory_order_relaxed);
+      c.waitNs.fetch_add(ret - waitStart, std::memory_order_relaxed);
+      atomicMax(c.maxWaitNs, ret - waitStart);
+    }
+    return ret;
+  };
+
+  void lockSite::released(counts_t& c, uint64_t heldSince) { //static
+    const uint64_t held = now() - heldSince;
+    c.holdNs.fetch_add(held, std::memory_order_relaxed);
+    atomicMax(c.maxHoldNs, held);
+  };
+
+  void profiler::printLockData(std::ostream& out) { //static
+    std::vector<std::pair<const lockSite*, bool>> rows;//bool: shared
+    {
+      std::lock_guard<std::mutex> lock(lockSitesMutex());
+      for(auto& pair : lockSites()) {
+	if(pair.second.exclusive.acquisitions.load())
+	  rows.emplace_back(&pair.second, false);
+	if(pair.second.shared.acquisitions.load())
+	  rows.emplace_back(&pair.second, true);
+      }
+    }
+    if(rows.empty()) return;
+    //sites live as long as the program, so no lock needed past here
+    auto counts = [](auto& row) -> const lockSite::counts_t& { return row.second ? row.first->shared : row.first->exclusive; };
+    std::sort(rows.begin(), rows.end(), [&counts](const auto& a, const auto& b) { return counts(a).waitNs.load() > counts(b).waitNs.load(); });
+    for(auto& row : rows) {
+      const lockSite::counts_t& c = counts(row);
+      const uint64_t acquisitions = c.acquisitions.load(), contended = c.contended.load();
+      out << "lock " << row.first->name << (row.second ? " (read)" : "") <<
+	": 	acquisitions: " << acquisitions <<
+	" 	contended: " << contended <<
+	" 	wait total: " << c.waitNs.load() <<
+	" 	wait average: " << (contended ? c.waitNs.load() / contended : 0) <<
+	" 	wait max: " << c.maxWaitNs.load() <<
+	" 	hold total: " << c.holdNs.load() <<
+	" 	hold average: " << c.holdNs.load() / acquisitions <<
+	" 	hold max: " << c.maxHoldNs.load() << "\n";
+    }
+  };
 
   uint64_t profiler::getNs() { //static
     return std::chrono::time_point_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()).time_since_epoch().count();
@@ -36,6 +113,12 @@ namespace WITE {
     std::unique_ptr<ProfileData*[]> data;
     size_t cnt;
     auto totalExecutions = allProfilesExecutions.load();
+    {
+      std::lock_guard<std::mutex> lock(allProfiles_mutex);
+      for(auto& pair : statsSources)
+	pair.second(std::cout);
+    }
+    printLockData(std::cout);
     if(totalExecutions == 0) {
       printf("No profile data");
       return;
@@ -62,6 +145,16 @@ namespace WITE {
       " \taverage: " << (allProfilesMutexTime.load() / totalExecutions) << "\n";
   };
 
+  void profiler::addStatsSource(const void* owner, std::function<void(std::ostream&)> printer) { //static
+    std::lock_guard<std::mutex> lock(allProfiles_mutex);
+    statsSources[owner] = printer;
+  };
+
+  void profiler::removeStatsSource(const void* owner) { //static
+    std::lock_guard<std::mutex> lock(allProfiles_mutex);
+    statsSources.erase(owner);
+  };
+
   profiler::profiler(hash_t hash, const char* filename, const char* funcname, uint64_t linenum, const char* message) :
     h(hash)
   {
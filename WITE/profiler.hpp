@@ -17,14 +17,20 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include <atomic>
 #include <mutex> //not using SyncLock because we want to profile it too
 #include <map>
+#include <functional>
+#include <ostream>
 
 #ifdef DO_PROFILE
 #define PROFILEME ::WITE::profiler UNIQUENAME(wite_function_profiler) (::WITE::profiler::hash(__FILE__, __func__, __LINE__, ""), __FILE__, __func__, __LINE__, "")
 #define PROFILEME_MSG(MSG) ::WITE::profiler UNIQUENAME(wite_function_profiler) (::WITE::profiler::hash(__FILE__, __func__, __LINE__, MSG), __FILE__, __func__, __LINE__, MSG)
-#define PROFILE_DUMP ::WITE::profiler::printProfileData();
 #else
 #define PROFILEME
 #define PROFILEME_MSG(MSG)
+#endif
+
+#if defined(DO_PROFILE) || defined(WITE_LOCK_PROFILE)
+#define PROFILE_DUMP ::WITE::profiler::printProfileData();
+#else
 #define PROFILE_DUMP
 #endif
 
@@ -41,6 +47,7 @@ namespace WITE {
     static std::map<hash_t, ProfileData> allProfiles;
     static std::mutex allProfiles_mutex;
     static std::atomic_uint64_t allProfilesMutexTime, allProfilesExecutions;
+    static std::map<const void*, std::function<void(std::ostream&)>> statsSources;//guarded by allProfiles_mutex
     static uint64_t getNs();
     char identifier[4096];
     uint64_t startTime;
@@ -60,7 +67,12 @@ namespace WITE {
       return hash;
     };
 
-    static void printProfileData();
+    static void printProfileData();//also prints stats sources and lock sites
+    static void printLockData(std::ostream& out);//lock sites with any acquisitions, most waited on first. Only populated with WITE_LOCK_PROFILE
+
+    //things with maintained statistics (like indices) can have them printed by printProfileData. owner is only a key for removal.
+    static void addStatsSource(const void* owner, std::function<void(std::ostream&)> printer);
+    static void removeStatsSource(const void* owner);
 
     profiler(hash_t hash, const char* filename, const char* funcname, uint64_t linenum, const char* message);//hash is split off so it can be constexpr
     ~profiler();
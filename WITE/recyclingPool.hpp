@@ -22,7 +22,7 @@ namespace WITE {
 
   template<typename T, bool doLock = true> class recyclingPool {
   private:
-    syncLock lock;
+    syncLock lock { "recyclingPool::lock" };
     std::deque<T> store;
     std::stack<T*> available;
   public:
@@ -0,0 +1,91 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <memory>
+
+namespace WITE {
+
+  //append-only array whose elements never move once created. Segment s holds 2^s elements, so growing never copies or frees existing storage.
+  //push_back must be externally synchronized with other push_backs, but reads may happen concurrently with a push_back.
+  template<class T> class stableVector {
+  private:
+    static constexpr size_t maxSegments = 64;
+    std::unique_ptr<T[]> segments[maxSegments];
+    std::atomic_size_t count = 0;
+
+    static inline size_t segmentOf(size_t idx) {
+      return std::bit_width(idx + 1) - 1;
+    };
+
+    static inline size_t offsetOf(size_t idx, size_t segment) {
+      return idx + 1 - (size_t(1) << segment);
+    };
+
+  public:
+    stableVector() = default;
+    stableVector(const stableVector&) = delete;
+    stableVector(stableVector&&) = delete;
+
+    inline T& operator[](size_t idx) {
+      size_t s = segmentOf(idx);
+      return segments[s][offsetOf(idx, s)];
+    };
+
+    inline const T& operator[](size_t idx) const {
+      size_t s = segmentOf(idx);
+      return segments[s][offsetOf(idx, s)];
+    };
+
+    //the element is fully written before the new size is published
+    T& push_back(const T& t) {
+      T& ret = emplace_back();
+      ret = t;
+      count.fetch_add(1, std::memory_order_release);
+      return ret;
+    };
+
+    //default-constructs the new element but does NOT publish it, call push_back or publish()
+    T& emplace_back() {
+      size_t idx = count.load(std::memory_order_relaxed), s = segmentOf(idx);
+      if(!segments[s]) [[unlikely]]
+	segments[s] = std::make_unique<T[]>(size_t(1) << s);
+      return segments[s][offsetOf(idx, s)];
+    };
+
+    inline void publish() {
+      count.fetch_add(1, std::memory_order_release);
+    };
+
+    inline size_t size() const {
+      return count.load(std::memory_order_acquire);
+    };
+
+    inline bool empty() const {
+      return size() == 0;
+    };
+
+    //frees all storage. NOT safe with concurrent reads.
+    void clear() {
+      count.store(0, std::memory_order_relaxed);
+      for(auto& s : segments)
+	s.reset();
+    };
+
+  };
+
+}
@@ -25,22 +25,39 @@ namespace WITE {
   void syncLock::WaitForLock(bool busy) {
     uint64_t seed;
     seed = queueSeed.fetch_add(1);//take a number
-    uint32_t sleepCnt = 0;
-    while (seed > queueCurrent.load())
-      if(!busy) [[likely]]
-	thread::sleepShort(sleepCnt);
+#ifdef WITE_LOCK_PROFILE
+    const bool contended = seed != queueCurrent.load();
+    const uint64_t waitStart = site && contended ? lockSite::now() : 0;
+#endif
+    if(busy) [[unlikely]]
+      while (seed > queueCurrent.load());
+    else
+      thread::waitFor(queueCurrent, [this, seed]() { return seed <= queueCurrent.load(); });
+#ifdef WITE_LOCK_PROFILE
+    if(site) heldSince = lockSite::acquired(site->exclusive, waitStart, contended);
+#endif
   }
 
   void syncLock::ReleaseLock() {
+#ifdef WITE_LOCK_PROFILE
+    if(site) lockSite::released(site->exclusive, heldSince);
+#endif
     queueCurrent.fetch_add(1);
+    queueCurrent.notify_all();//whoever holds the next ticket might be parked. No syscall when nobody is.
   }
 
   void syncLock::yield() {
     uint64_t newSeed;
     newSeed = queueSeed.fetch_add(1);
-    queueCurrent.fetch_add(1);
-    uint32_t sleepCnt = 0;
-    while (newSeed > queueCurrent.load()) thread::sleepShort(sleepCnt);
+    ReleaseLock();
+#ifdef WITE_LOCK_PROFILE
+    const bool contended = newSeed != queueCurrent.load();
+    const uint64_t waitStart = site && contended ? lockSite::now() : 0;
+#endif
+    thread::waitFor(queueCurrent, [this, newSeed]() { return newSeed <= queueCurrent.load(); });
+#ifdef WITE_LOCK_PROFILE
+    if(site) heldSince = lockSite::acquired(site->exclusive, waitStart, contended);
+#endif
   }
 
   bool syncLock::isHeld() {
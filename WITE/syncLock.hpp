@@ -16,11 +16,18 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #include <atomic>
 
+#include "lockProfile.hpp"
+
 namespace WITE {
 
   class syncLock {
   public:
     syncLock();
+#ifdef WITE_LOCK_PROFILE
+    syncLock(const char* siteName) : site(lockSite::get(siteName)) {};
+#else
+    syncLock(const char*) {};//site name, for WITE_LOCK_PROFILE
+#endif
     void WaitForLock(bool busy = false);
     void ReleaseLock();
     void yield();
@@ -28,6 +35,10 @@ namespace WITE {
   private:
     typedef std::atomic<uint64_t> ticket_t;
     ticket_t queueSeed, queueCurrent;
+#ifdef WITE_LOCK_PROFILE
+    lockSite* site = NULL;
+    uint64_t heldSince;//only touched by the holder
+#endif
   };
 
   class scopeLock {
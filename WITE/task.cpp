@@ -0,0 +1,81 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#include <deque>
+#include <vector>
+
+#include "task.hpp"
+#include "thread.hpp"
+#include "syncLock.hpp"
+#include "configuration.hpp"
+
+namespace WITE {
+
+  struct taskIoService_t {
+    syncLock queueMutex { "taskIo::queueMutex" };
+    std::deque<taskIo::ioJob_t> queue;
+    std::atomic_uint32_t queued = 0;//workers park on this
+    std::atomic_bool exit = false;
+    std::vector<thread*> workers;
+
+    taskIoService_t() {
+      const uint32_t count = std::max<uint32_t>(1, configuration::getOption("iothreads", 2));
+      for(uint32_t i = 0;i < count;i++)
+	workers.push_back(thread::spawnThread(thread::threadEntry_t_F::make([this]() { work(); })));
+    };
+
+    //jobs still queued are dropped. The tasks waiting on them are never resumed, as the program is ending.
+    ~taskIoService_t() {
+      exit.store(true, std::memory_order_release);
+      queued.fetch_add(1, std::memory_order_release);
+      queued.notify_all();
+      for(thread* t : workers)
+	t->join();
+    };
+
+    void work() {
+      while(true) {
+	thread::waitFor(queued, [this]() { return queued.load(std::memory_order_acquire) || exit.load(std::memory_order_acquire); });
+	if(exit.load(std::memory_order_acquire)) [[unlikely]] return;
+	taskIo::ioJob_t job;
+	{
+	  scopeLock l(&queueMutex);
+	  if(queue.empty()) continue;//exiting, or another worker took it
+	  job = std::move(queue.front());
+	  queue.pop_front();
+	  queued.fetch_sub(1, std::memory_order_relaxed);
+	}
+	job();
+      }
+    };
+
+  };
+
+  //constructed on first use, so it is destroyed (and its threads joined) before the thread registry is
+  static taskIoService_t& ioService() {
+    static taskIoService_t ret;
+    return ret;
+  };
+
+  void taskIo::submit(ioJob_t job) {//static
+    taskIoService_t& s = ioService();
+    {
+      scopeLock l(&s.queueMutex);
+      s.queue.push_back(std::move(job));
+      s.queued.fetch_add(1, std::memory_order_release);//under the lock, so it never counts less than the queue holds
+    }
+    s.queued.notify_one();
+  };
+
+}
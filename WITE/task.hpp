@@ -0,0 +1,234 @@
+/*
+Copyright 2020-2025 Wafflecat Games, LLC
+
+This file is part of WITE.
+
+WITE is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+WITE is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with WITE. If not, see <https://www.gnu.org/licenses/>.
+
+Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
+*/
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "threadPool.hpp"
+#include "callback.hpp"
+
+namespace WITE {
+
+  //dedicated threads for blocking calls (file io, fence waits) made on behalf of tasks, so a task waiting on one doesn't hold a pool worker
+  //started on first use. Option iothreads (default 2).
+  class taskIo {
+  public:
+    typedefCB(ioJob_t, void);
+    static void submit(ioJob_t job);
+  };
+
+  //the job that resumes a suspended task. data[0] is the coroutine handle's address.
+  template<class H> struct resumeJob_t {
+    static void cb(threadPool::jobData_t& jd) { H::from_address(reinterpret_cast<void*>(jd[0])).resume(); };
+    static constexpr threadPool::jobEntry_t_F::StaticCallback<> cbt = &cb;
+    static constexpr threadPool::jobEntry_t_ce cbce = &cbt;
+  };
+
+  //coroutines that run as threadPool jobs. A task suspends at co_await instead of blocking its worker, and is resumed by a new job when what it awaited is done.
+  //a task does nothing until it is either spawned (detached: it destroys itself when it ends) or awaited by another task (which it then runs inline, and resumes after).
+  //  task<int> load(path) { ...; co_return n; }
+  //  task<> tick() { int n = co_await load(p); co_await task<>::resumeIn(lane_e::eBackground); ... }
+  //  tick().spawn(pool, &counter);
+  //a resumed task runs on whichever worker picks up the job, so nothing thread-specific (threadResource entries, tempCmds, row locks) should be held across a co_await.
+  class taskBase {
+  public:
+    //what every task's promise has, whatever it returns: where to resume it, and what to do when it ends
+    struct promiseBase_t {
+      threadPool* pool = NULL;
+      threadPool::counter_t* counter = NULL;//detached tasks only: held from spawn until the task ends
+      threadPool::lane_e lane = threadPool::lane_e::eNormal;//for resuming after an await. Inherited from the awaiting task.
+      std::coroutine_handle<> continuation;//the task awaiting this one, if any
+      bool detached = false;
+
+      std::suspend_always initial_suspend() noexcept { return {}; };
+
+      struct finalAwaiter_t {
+	bool await_ready() noexcept { return false; };
+	template<class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+	  promiseBase_t& p = h.promise();
+	  if(!p.detached)
+	    return p.continuation;//which destroys this frame once it has the result
+	  threadPool* pool = p.pool;
+	  threadPool::counter_t* counter = p.counter;
+	  h.destroy();
+	  if(counter)
+	    pool->release(*counter);//last, so whoever waits on the counter can't see it done before the frame is gone
+	  return std::noop_coroutine();
+	};
+	void await_resume() noexcept {};
+      };
+
+      finalAwaiter_t final_suspend() noexcept { return {}; };
+      void unhandled_exception() noexcept { std::terminate(); };
+    };
+
+    //submits a job that resumes h on pool
+    template<class H> static void resume(threadPool* pool, H h, threadPool::lane_e lane) {
+      threadPool::job_t j = resumeJob(h, lane);
+      pool->submitJob(&j);
+    };
+
+    template<class H> static threadPool::job_t resumeJob(H h, threadPool::lane_e lane) {
+      return { threadPool::jobEntry_t(resumeJob_t<H>::cbce), { reinterpret_cast<uint64_t>(h.address()) }, lane };
+    };
+
+    //awaitables for use inside any task:
+
+    //continues as a new job in the given lane (which also becomes the lane for later resumes)
+    struct resumeIn_t {
+      threadPool::lane_e lane;
+      bool await_ready() noexcept { return false; };
+      template<class P> void await_suspend(std::coroutine_handle<P> h) {
+	promiseBase_t& p = h.promise();
+	p.lane = lane;
+	resume(p.pool, h, lane);
+      };
+      void await_resume() noexcept {};
+    };
+    static resumeIn_t resumeIn(threadPool::lane_e lane) { return { lane }; };
+
+    //continues once every job (and task) counted by c is done. c must be counting on the same pool as this task runs on.
+    struct after_t {
+      threadPool::counter_t& c;
+      bool await_ready() noexcept { return c.done(); };
+      template<class P> void await_suspend(std::coroutine_handle<P> h) {
+	promiseBase_t& p = h.promise();
+	threadPool::job_t j = resumeJob(h, p.lane);
+	p.pool->then(c, &j);
+      };
+      void await_resume() noexcept {};
+    };
+    static after_t after(threadPool::counter_t& c) { return { c }; };
+
+    //runs f() on an io thread and continues with its result. For calls that block (io, fence waits), which would otherwise hold a worker.
+    template<class F> struct blocking_t {
+      typedef std::invoke_result_t<F&> result_t;
+      F f;
+      std::conditional_t<std::is_void_v<result_t>, bool, std::optional<result_t>> result {};
+      bool await_ready() noexcept { return false; };
+      template<class P> void await_suspend(std::coroutine_handle<P> h) {
+	promiseBase_t& p = h.promise();
+	threadPool* pool = p.pool;
+	const threadPool::lane_e lane = p.lane;
+	//this awaiter lives in h's frame, and h may be resumed (and this destroyed) the moment resume is called, so nothing touches this after that
+	taskIo::submit(taskIo::ioJob_t_F::make([this, pool, h, lane]() {
+	  if constexpr(std::is_void_v<result_t>)
+	    f();
+	  else
+	    result.emplace(f());
+	  resume(pool, h, lane);
+	}));
+      };
+      result_t await_resume() {
+	if constexpr(std::is_void_v<result_t>)
+	  return;
+	else
+	  return std::move(*result);
+      };
+    };
+    template<class F> static blocking_t<F> blocking(F f) { return { std::move(f) }; };
+
+    //file io on an io thread. Both return the number of bytes actually transferred.
+    static auto readFile(std::filesystem::path path, uint64_t offset, void* out, uint64_t size) {
+      return blocking([path, offset, out, size]() -> uint64_t {
+	std::ifstream in(path, std::ios::binary);
+	if(!in || !in.seekg(offset)) [[unlikely]] return 0;
+	in.read(reinterpret_cast<char*>(out), size);
+	return in.gcount();
+      });
+    };
+
+    static auto writeFile(std::filesystem::path path, uint64_t offset, const void* data, uint64_t size) {
+      return blocking([path, offset, data, size]() -> uint64_t {
+	if(!std::filesystem::exists(path))
+	  std::ofstream(path, std::ios::binary);//create it, as fstream won't
+	std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+	if(!out || !out.seekp(offset)) [[unlikely]] return 0;
+	out.write(reinterpret_cast<const char*>(data), size);
+	return out ? size : 0;
+      });
+    };
+
+  };
+
+  template<class T> struct taskResult_t {
+    std::optional<T> value;
+    template<class U> void return_value(U&& v) { value.emplace(std::forward<U>(v)); };
+    T take() { return std::move(*value); };
+  };
+
+  template<> struct taskResult_t<void> {
+    void return_void() {};
+    void take() {};
+  };
+
+  template<class T = void> class task : public taskBase {
+  public:
+    struct promise_type : promiseBase_t, taskResult_t<T> {
+      task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); };
+    };
+
+    task(task&& o) : h(std::exchange(o.h, nullptr)) {};
+    task(const task&) = delete;
+    ~task() {
+      if(h) h.destroy();//never started
+    };
+
+    //runs the task on pool, starting with a job in lane, and lets it go: it destroys itself when it ends (and any result is dropped). counter, if any, counts it until then.
+    void spawn(threadPool& pool, threadPool::counter_t* counter = NULL, threadPool::lane_e lane = threadPool::lane_e::eNormal) && {
+      promise_type& p = h.promise();
+      p.pool = &pool;
+      p.counter = counter;
+      p.lane = lane;
+      p.detached = true;
+      if(counter)
+	pool.hold(*counter);
+      resume(&pool, std::exchange(h, nullptr), lane);
+    };
+
+    //co_await from inside another task: runs this one right away on the same thread, and continues the awaiting task with its result when it ends
+    struct awaiter_t {
+      std::coroutine_handle<promise_type> h;
+      bool await_ready() noexcept { return false; };
+      template<class P> std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) {
+	promiseBase_t& pp = parent.promise();
+	promise_type& p = h.promise();
+	p.pool = pp.pool;
+	p.lane = pp.lane;
+	p.continuation = parent;
+	return h;
+      };
+      T await_resume() {
+	struct destroyer_t { std::coroutine_handle<promise_type> h; ~destroyer_t() { h.destroy(); }; } d { h };
+	return h.promise().take();
+      };
+    };
+
+    awaiter_t operator co_await() && {
+      return { std::exchange(h, nullptr) };
+    };
+
+  private:
+    std::coroutine_handle<promise_type> h;
+    explicit task(std::coroutine_handle<promise_type> h) : h(h) {};
+  };
+
+}
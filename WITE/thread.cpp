@@ -15,13 +15,24 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #ifndef iswindows //*nix way to get cpu core count (guess)
 #include <unistd.h>
 #include <sys/sysinfo.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
 #else
 #include <windows.h>
 #endif
 
 #include <chrono>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <functional>
 
 #include "thread.hpp"
+#include "configuration.hpp"
 #include "DEBUG.hpp"
 
 namespace WITE {
@@ -32,6 +43,66 @@ namespace WITE {
   };
 
   threadResource<thread> thread::threads;//static
+  std::atomic_uint32_t thread::spinBudget = 128, thread::yieldBudget = 64;//static
+
+  //thread indices. Function statics that are never freed, as threads may come and go during static construction and destruction.
+  static syncLock& idxMutex() {
+    static syncLock* ret = new syncLock();
+    return *ret;
+  };
+
+  static std::vector<uint32_t>& freeIdxs() {//min heap, so the lowest free index is reused first and the indices stay dense
+    static std::vector<uint32_t>* ret = new std::vector<uint32_t>();
+    return *ret;
+  };
+
+  static uint32_t nextIdx = 0;//guarded by idxMutex
+
+  //gives the index back when its thread exits, unless the thread was spawned, in which case join does
+  struct idxReleaser {
+    uint32_t idx = thread::noIdx;
+    bool releaseOnExit = true;
+    ~idxReleaser();
+  };
+
+  static thread_local idxReleaser releaser;
+  static thread_local bool releaserGone = false;//trivially destructible, so it can be read after releaser is destroyed
+
+  idxReleaser::~idxReleaser() {
+    releaserGone = true;
+    thread::currentIdx = thread::noIdx;//anything asking after this gets an index that is never given back, rather than one that might be reused under it
+    if(releaseOnExit && idx != thread::noIdx) {
+      if(thread* t = thread::threads.getIfExists(idx))
+	t->idx = thread::noIdx;//so the next owner of the index fills in its own tid
+      thread::releaseIdx(idx);
+    }
+  };
+
+  uint32_t thread::assignIdx() {//static
+    uint32_t ret;
+    {
+      scopeLock lock(&idxMutex());
+      auto& free = freeIdxs();
+      if(free.empty()) {
+	ret = nextIdx++;
+      } else {
+	std::pop_heap(free.begin(), free.end(), std::greater<uint32_t>());
+	ret = free.back();
+	free.pop_back();
+      }
+    }
+    currentIdx = ret;
+    if(!releaserGone) [[likely]]
+      releaser.idx = ret;
+    return ret;
+  };
+
+  void thread::releaseIdx(uint32_t idx) {//static
+    scopeLock lock(&idxMutex());
+    auto& free = freeIdxs();
+    free.push_back(idx);
+    std::push_heap(free.begin(), free.end(), std::greater<uint32_t>());
+  };
 
   tid_t thread::getCurrentTid() {//static
     return std::this_thread::get_id();
@@ -39,38 +110,44 @@ namespace WITE {
 
   void thread::init() {//static
     //this did something back in the pthread days
+    spinBudget.store(configuration::getOption("spinbudget", spinBudget.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+    yieldBudget.store(configuration::getOption("yieldbudget", yieldBudget.load(std::memory_order_relaxed)), std::memory_order_relaxed);
     initThisThread();
   };
 
   void thread::initThisThread() {//static
-    threads.get()->tid = getCurrentTid();
+    current();
   };
 
   thread* thread::spawnThread(threadEntry_t entry) {//static
-    std::atomic_uint8_t sem = 0;
-    std::thread* baby = new std::thread([entry, &sem](){
-      {
-	uint32_t counter = 0;
-	while(sem == 0) sleepShort(counter);
-	sem = 2;
-      }//parent has finished prepping ret. Also sem becomes invalid here
-      initThisThread();
+    std::atomic<thread*> born = NULL;
+    std::thread* baby = new std::thread([entry, &born](){
+      releaser.releaseOnExit = false;//join gives the index back, so it is not reused (with this thread object) before then
+      born.store(current());//last touch of born, which is on the parent's stack
       if(entry) [[likely]] entry();
     });
-    thread* ret = threads.get(baby->get_id());
-    ret->threadObj.reset(baby);
-    sem = 1;//done preparing baby thread's home
     uint32_t counter = 0;
-    while(sem != 2) sleepShort(counter);//don't return until we know the baby thread is done with sem
+    thread* ret;
+    while(!(ret = born.load())) sleepShort(counter);
+    ret->threadObj.reset(baby);
     return ret;
   };
 
   thread* thread::current() {//static
-    return threads.get();
+    thread* ret = threads.get();
+    if(ret->idx != currentIdx) [[unlikely]] {
+      //first call from this thread, or this object was left behind by the last thread to have this index
+      ret->tid = getCurrentTid();
+      ret->idx = currentIdx;
+    }
+    return ret;
   };
 
   thread* thread::get(tid_t tid) {//static
-    return threads.get(tid);
+    for(thread& t : threads)
+      if(t.tid == tid)
+	return &t;
+    return NULL;
   };
 
   void thread::sleep(uint64_t ns) {//static
@@ -111,15 +188,145 @@ namespace WITE {
     return int32_t(ret);
   };
 
+  //"0-3,8,10-11", the format of /sys and taskset. Anything else (garbage, a reversed range, a cpu id of maxCpus or more) rejects the whole list: it warns and returns an empty list.
+  std::vector<uint32_t> thread::parseCpuList(const char* list) {//static
+    std::vector<uint32_t> ret;
+    if(!list) return ret;
+    const char* c = list;
+    auto number = [&c](uint32_t& out) {
+      if(!std::isdigit(static_cast<unsigned char>(*c))) return false;//strtoul would take a sign or leading space
+      char* end;
+      const unsigned long v = std::strtoul(c, &end, 10);
+      c = end;
+      out = static_cast<uint32_t>(v);
+      return v < maxCpus;
+    };
+    if(!*c) return ret;
+    bool valid;
+    do {
+      uint32_t first = 0, last = 0;
+      valid = number(first);
+      last = first;
+      if(valid && *c == '-') {
+	c++;
+	valid = number(last) && last >= first;
+      }
+      if(!valid) [[unlikely]] break;
+      for(uint32_t i = first;i <= last;i++)
+	ret.push_back(i);
+    } while(*c++ == ',');
+    c--;
+    while(std::isspace(static_cast<unsigned char>(*c)))
+      c++;
+    if(!valid || *c) [[unlikely]] {
+      WARN("invalid cpu list, ignoring it: ", list);
+      ret.clear();
+    }
+    return ret;
+  };
+
+  const std::vector<std::vector<uint32_t>>& thread::numaNodes() {//static
+    static const std::vector<std::vector<uint32_t>> nodes = []() {
+      std::vector<uint32_t> allowed;
+      if(const char* cpus = configuration::getOption("threadcpus"))
+	allowed = parseCpuList(cpus);
+      if(allowed.empty()) {//not given, or invalid
+#ifndef iswindows
+	cpu_set_t set;
+	if(sched_getaffinity(0, sizeof(set), &set) == 0)
+	  for(uint32_t i = 0;i < CPU_SETSIZE;i++)
+	    if(CPU_ISSET(i, &set))
+	      allowed.push_back(i);
+#endif
+	if(allowed.empty())
+	  for(int32_t i = 0;i < guessCpuCount();i++)
+	    allowed.push_back(i);
+      }
+      std::sort(allowed.begin(), allowed.end());
+      std::vector<std::vector<uint32_t>> ret;
+      if(const char* manual = configuration::getOption("threadnodes")) {
+	std::string list = manual;
+	size_t start = 0;
+	while(start <= list.size()) {
+	  const size_t end = std::min(list.find('/', start), list.size());
+	  ret.push_back(parseCpuList(list.substr(start, end - start).c_str()));
+	  start = end + 1;
+	}
+      } else {
+#ifndef iswindows
+	for(uint32_t n = 0;;n++) {
+	  std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+	  if(!in) break;
+	  std::string line;
+	  std::getline(in, line);
+	  ret.push_back(parseCpuList(line.c_str()));
+	}
+#endif
+      }
+      //keep only allowed cpus, and drop nodes left empty (memory-only nodes have no cpus anyway)
+      for(auto& node : ret)
+	std::erase_if(node, [&allowed](uint32_t cpu) { return !std::binary_search(allowed.begin(), allowed.end(), cpu); });
+      std::erase_if(ret, [](const std::vector<uint32_t>& node) { return node.empty(); });
+      if(ret.empty())
+	ret.push_back(allowed);
+      return ret;
+    }();
+    return nodes;
+  };
+
+  bool thread::setAffinity(const std::vector<uint32_t>& cpus) {//static
+#ifndef iswindows
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(uint32_t cpu : cpus)
+      if(cpu < CPU_SETSIZE) [[likely]]
+	CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    DWORD_PTR mask = 0;
+    for(uint32_t cpu : cpus)
+      if(cpu < sizeof(mask) * 8)
+	mask |= DWORD_PTR(1) << cpu;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#endif
+  };
+
+  uint32_t thread::currentCpu() {//static
+#ifndef iswindows
+    const int ret = sched_getcpu();
+    return ret < 0 ? 0 : static_cast<uint32_t>(ret);
+#else
+    return GetCurrentProcessorNumber();
+#endif
+  };
+
+  void thread::ignoreBrokenPipe() {//static
+#ifndef iswindows
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+#endif
+    //windows reports a closed pipe as a failed write already
+  };
+
   tid_t thread::getTid() {
     return tid;
   };
 
+  uint32_t thread::getIdx() {
+    return idx;
+  };
+
   void thread::join(){
-    if(threadObj && threadObj->joinable())
+    if(threadObj && threadObj->joinable()) {
       threadObj->join();
-    else
+      const uint32_t was = idx;
+      idx = noIdx;//so the next owner of the index fills in its own tid
+      releaseIdx(was);
+    } else {
       WARN("Not joining thread because it is not joinable");
+    }
   };
 
 }
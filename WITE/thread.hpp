@@ -15,8 +15,10 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #pragma once
 
 #include <thread>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "syncLock.hpp"
 #include "callback.hpp"
@@ -29,6 +31,8 @@ namespace WITE {
   typedef std::thread::id tid_t;
   tid_t tid_none();
 
+  //one T per thread, made on first use by that thread. Indexed by the dense thread index, so get() is a thread_local load and two array reads, with no lock.
+  //a thread index is reused once its thread is gone, and the T it left behind goes with it, so T should not assume a fresh thread.
   template<class T> class threadResource {
   public:
     typedef T* Tentry;
@@ -37,6 +41,17 @@ namespace WITE {
     template<typename U = T, std::enable_if_t<std::is_default_constructible<U>::value, int> = 0>
     threadResource() : threadResource(Initer_F::make(&makeDefault)) {};
     threadResource(Initer typeInit) : typeInit(typeInit) {};
+    threadResource(const threadResource&) = delete;
+
+    ~threadResource() {
+      for(auto& c : chunks) {
+	chunk_t* chunk = c.load(std::memory_order_relaxed);
+	if(!chunk) continue;
+	for(auto& e : chunk->entries)
+	  delete e.load(std::memory_order_relaxed);
+	delete chunk;
+      }
+    };
 
     template<typename U = T, std::enable_if_t<std::is_default_constructible<U>::value, int> = 0>
     static Tentry makeDefault() {
@@ -45,72 +60,155 @@ namespace WITE {
 
     T* get();
 
-    T* get(tid_t tid) {
-      scopeLock contextHold(&lock);
-      auto& d = data[tid];
-      if(!d && typeInit)
-	d.reset(typeInit());
-      return d.get();
+    T* get(uint32_t threadIdx) {
+      std::atomic<T*>& e = entry(threadIdx);
+      T* ret = e.load(std::memory_order_acquire);
+      if(!ret && typeInit) [[unlikely]] {
+	//normally only the owning thread gets here, but anyone may ask for any index
+	T* made = typeInit();
+	if(e.compare_exchange_strong(ret, made, std::memory_order_acq_rel))
+	  ret = made;
+	else
+	  delete made;
+      }
+      return ret;
     };
 
-    T* getIfExists(tid_t tid) {
-      scopeLock contextHold(&lock);
-      return data[tid].get();
+    T* getIfExists(uint32_t threadIdx) {
+      chunk_t* c = chunks[threadIdx / chunkSize].load(std::memory_order_acquire);
+      return c ? c->entries[threadIdx % chunkSize].load(std::memory_order_acquire) : NULL;
     };
 
     size_t listAll(Tentry* out, size_t maxOut) {
-      scopeLock contextHold(&lock);
       size_t count = 0;
-      for(auto& pair : data)
+      for(T& t : *this)
 	if(count < maxOut)
-	  out[count++] = pair.second.get();
+	  out[count++] = &t;
       return count;
     };
 
     void each(callbackPtr<void, T&> cb) {
-      scopeLock contextHold(&lock);
-      for(auto& pair : data)
-	cb(pair.second.get());
+      for(T& t : *this)
+	cb(t);
+    };
+
+    //visits every T made so far. Safe while other threads make theirs, which may or may not be visited.
+    class iterator {
+    private:
+      threadResource* owner;
+      uint32_t idx;
+      void skipEmpty() {
+	while(idx < maxThreads && !owner->getIfExists(idx)) {
+	  if(!owner->chunks[idx / chunkSize].load(std::memory_order_acquire))
+	    idx = (idx / chunkSize + 1) * chunkSize;
+	  else
+	    idx++;
+	}
+      };
+    public:
+      iterator(threadResource* owner, uint32_t idx) : owner(owner), idx(idx) { skipEmpty(); };
+      T& operator*() { return *owner->getIfExists(idx); };
+      T* operator->() { return owner->getIfExists(idx); };
+      iterator& operator++() { idx++; skipEmpty(); return *this; };
+      bool operator==(const iterator& o) const { return idx == o.idx; };
+      uint32_t threadIdx() { return idx; };
     };
 
     auto inline begin() {
-      return data.begin();
+      return iterator(this, 0);
     };
 
     auto inline end() {
-      return data.end();
+      return iterator(this, maxThreads);
     };
 
   private:
+    static constexpr uint32_t chunkSize = 64, chunkCount = 256, maxThreads = chunkSize * chunkCount;
+    struct chunk_t {
+      std::atomic<T*> entries[chunkSize] = {};
+    };
     Initer typeInit;
-    std::map<tid_t, std::unique_ptr<T>> data;
-    syncLock lock;
+    std::atomic<chunk_t*> chunks[chunkCount] = {};//allocated when a thread index in that range first asks
+
+    std::atomic<T*>& entry(uint32_t threadIdx) {
+      ASSERT_TRAP(threadIdx < maxThreads, "too many threads for threadResource");
+      std::atomic<chunk_t*>& c = chunks[threadIdx / chunkSize];
+      chunk_t* chunk = c.load(std::memory_order_acquire);
+      if(!chunk) [[unlikely]] {
+	chunk_t* made = new chunk_t();
+	if(c.compare_exchange_strong(chunk, made, std::memory_order_acq_rel))
+	  chunk = made;
+	else
+	  delete made;
+      }
+      return chunk->entries[threadIdx % chunkSize];
+    };
   };
 
   class thread {
   public:
     typedefCB(threadEntry_t, void);
-    static tid_t getCurrentTid();//returns engine thread index, NOT system tid. Can be used to index.
+    static tid_t getCurrentTid();//system thread id, for comparison. See getCurrentIdx to index things.
+    static constexpr uint32_t noIdx = ~uint32_t(0);
+    //small dense index of the calling thread, for threadResource. Given out lowest first on a thread's first call, and taken back when it is joined (spawned threads) or exits (others).
+    static inline uint32_t getCurrentIdx() {
+      if(currentIdx == noIdx) [[unlikely]]
+	return assignIdx();
+      return currentIdx;
+    };
     static void init();
     static void initThisThread();
     static thread* spawnThread(threadEntry_t entry);//all spawned threads should be joined
     static thread* current();
-    static thread* get(tid_t tid);
+    static thread* get(tid_t tid);//NULL if no thread with that id has called current(). Not fast.
     static void sleep(uint64_t ns = 0);
     static void sleepSeconds(float s);//mostly for test cases (more readable 10000000000 ns)
     static void sleepShort();//for non-busy wait, wait aa very small amount of time
     static void sleepShort(uint32_t& counter, uint32_t busyCount = 128);//dynamically shifts from busy to non-busy wait based on iteration count
     static int32_t guessCpuCount();
+    //cpus this process may use, grouped by NUMA node. From sysfs where available, otherwise one node.
+    //options: threadcpus=<cpu list> limits the cpus (default: the process affinity), threadnodes=<cpu list>/<cpu list>/... replaces the detected nodes. A cpu list is like 0-3,8
+    static const std::vector<std::vector<uint32_t>>& numaNodes();
+    static constexpr uint32_t maxCpus = 8192;//cpu ids must be below this, the most linux supports
+    static std::vector<uint32_t> parseCpuList(const char*);
+    static bool setAffinity(const std::vector<uint32_t>& cpus);//pins the calling thread to these cpus. False if the platform refused.
+    static uint32_t currentCpu();
+    static void ignoreBrokenPipe();//for threads that write to pipes: writing after the reader has gone fails instead of raising SIGPIPE. Affects only the calling thread.
+    //blocks until done() returns true: spins, then yields, then parks on a (futex where available) so a long wait costs no cpu.
+    //whatever makes done() true must then change the value of a and notify it, or a parked waiter will never see it.
+    template<class T, class F> static void waitFor(std::atomic<T>& a, F done);
+    static std::atomic_uint32_t spinBudget, yieldBudget;//how many times waitFor polls busily, then with a yield, before parking. Options spinbudget and yieldbudget, read by init(). Atomic because init runs again for every pool while other threads wait.
     tid_t getTid();
+    uint32_t getIdx();
     void join();//all spawned threads should be joined
   private:
     static threadResource<thread> threads;
+    static inline thread_local uint32_t currentIdx = noIdx;
+    static uint32_t assignIdx();
+    static void releaseIdx(uint32_t);
+    friend struct idxReleaser;
     tid_t tid;
+    uint32_t idx = noIdx;
     std::unique_ptr<std::thread> threadObj;//might be null, for main or threads created by other means
   };
 
   template<class T> T* threadResource<T>::get() {
-    return get(thread::getCurrentTid());
+    return get(thread::getCurrentIdx());
   }
 
+  template<class T, class F> void thread::waitFor(std::atomic<T>& a, F done) {
+    const uint32_t spins = spinBudget.load(std::memory_order_relaxed), yields = yieldBudget.load(std::memory_order_relaxed);
+    for(uint32_t i = 0;i < spins;i++)
+      if(done()) [[likely]] return;
+    for(uint32_t i = 0;i < yields;i++) {
+      if(done()) return;
+      sleepShort();
+    }
+    while(true) {
+      const T v = a.load(std::memory_order_acquire);
+      if(done()) return;
+      a.wait(v, std::memory_order_acquire);//returns once a no longer holds v
+    }
+  };
+
 }
@@ -12,34 +12,279 @@ You should have received a copy of the GNU General Public License along with WIT
 Stable and intermediate releases may be made continually. For this reason, a year range is used in the above copyrihgt declaration. I intend to keep the "working copy" publicly visible, even if it is not functional. I consider every push to this publicly visible repository as a release. Releases intended to be stable will be marked as such via git tag or similar feature.
 */
 
+#include <cstring>
+
 #include "threadPool.hpp"
 #include "configuration.hpp"
 #include "math.hpp"
 
 namespace WITE {
 
-  void threadPool::workerEntry(threadPool::threadData_t* threadData) {
-    threadData->thread = thread::current();
-    auto readTarget = threadData->nextRead.load(std::memory_order_relaxed);//won't move till we move it so don't re-read it
-    uint32_t sleepCnt = 0;
-    while(!exit.load(std::memory_order_consume)) {
-      if(readTarget == threadData->nextWrite.load(std::memory_order_consume)) [[unlikely]] {//queue underflow
-	thread::sleepShort(sleepCnt);
-      } else {
-	sleepCnt = 0;
-	job_t& j = threadData->jobs[readTarget];
-	j.entry(j.data);
-	readTarget = (readTarget + 1) & jobMask;
-	threadData->nextRead.store(readTarget, std::memory_order_release);
+  thread_local threadPool::worker_t threadPool::currentWorker { NULL, NULL, threadPool::lane_e::eNormal };
+
+  bool threadPool::deque_t::push(uint32_t slot) {
+    const int64_t b = bottom.load(std::memory_order_relaxed), t = top.load(std::memory_order_acquire);
+    if(b - t >= capacity) [[unlikely]]
+      return false;
+    items[b & mask].store(slot, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+  };
+
+  uint32_t threadPool::deque_t::pop() {
+    const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if(t > b) {//empty
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return noSlot;
+    }
+    uint32_t ret = items[b & mask].load(std::memory_order_relaxed);
+    if(t == b) {//last one, race thieves for it
+      if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	ret = noSlot;
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return ret;
+  };
+
+  uint32_t threadPool::deque_t::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom.load(std::memory_order_acquire);
+    if(t >= b)
+      return noSlot;
+    uint32_t ret = items[t & mask].load(std::memory_order_relaxed);
+    if(!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return noSlot;
+    return ret;
+  };
+
+  uint32_t threadPool::allocateSlot() {
+    uint64_t head = freeSlots.load(std::memory_order_acquire);
+    while(true) {
+      const uint32_t idx = static_cast<uint32_t>(head);
+      if(idx == noSlot) [[unlikely]] {
+	//out of slots, add a batch. Slots are never released, so the pool only grows to the most jobs ever outstanding at once.
+	scopeLock l(&slotsGrowMutex);
+	head = freeSlots.load(std::memory_order_acquire);
+	if(static_cast<uint32_t>(head) != noSlot)
+	  continue;//someone else grew it
+	const uint32_t first = static_cast<uint32_t>(slots.size()), batch = max<uint32_t>(first, 64);
+	ASSERT_TRAP(uint64_t(first) + batch < noSlot, "too many outstanding jobs");
+	for(uint32_t i = 0;i < batch;i++) {
+	  slots.emplace_back().nextFree.store(first + i + 1, std::memory_order_relaxed);
+	  slots.publish();
+	}
+	//keep the first for ourselves and push the rest as one chain. freeSlot might have pushed since we looked, so splice onto whatever is there now.
+	head = freeSlots.load(std::memory_order_relaxed);
+	do {
+	  slots[first + batch - 1].nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+	} while(!freeSlots.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | (first + 1), std::memory_order_release, std::memory_order_relaxed));
+	return first;
+      }
+      const uint64_t next = ((head >> 32) + 1) << 32 | slots[idx].nextFree.load(std::memory_order_relaxed);
+      if(freeSlots.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) [[likely]]
+	return idx;
+    }
+  };
+
+  void threadPool::freeSlot(uint32_t idx) {
+    uint64_t head = freeSlots.load(std::memory_order_relaxed);
+    do {
+      slots[idx].nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    } while(!freeSlots.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | idx, std::memory_order_release, std::memory_order_relaxed));
+  };
+
+  //own deque, then own node (its shared queue, then its workers), then the other nodes the same way, so jobs and the memory they touch tend to stay on one node
+  uint32_t threadPool::findJobIn(threadData_t* self, size_t lane) {
+    uint32_t ret = self->jobs[lane].pop();
+    if(ret != noSlot) return ret;
+    for(uint32_t n = 0;n < nodeCount;n++) {
+      node_t& node = nodes[(self->node + n) % nodeCount];
+      if(node.injection[lane].pop(ret)) return ret;
+      const size_t count = node.workers.size();
+      for(size_t k = 1;k <= count;k++) {
+	threadData_t& victim = threads[node.workers[(self->idx + k) % count]];
+	if(&victim == self) continue;
+	ret = victim.jobs[lane].steal();
+	if(ret != noSlot) return ret;
       }
     }
+    return noSlot;
+  };
+
+  //highest lane first. A background job is only taken by a worker already inside one, or if that leaves no more than backgroundCap workers in one.
+  uint32_t threadPool::findJob(threadData_t* self) {
+    static constexpr size_t background = static_cast<size_t>(lane_e::eBackground);
+    uint32_t ret;
+    for(size_t lane = 0;lane < background;lane++) {
+      ret = findJobIn(self, lane);
+      if(ret != noSlot) return ret;
+    }
+    if(self->backgroundDepth)
+      return findJobIn(self, background);
+    if(!pending[background].load(std::memory_order_relaxed) || backgroundRunning.load(std::memory_order_relaxed) >= backgroundCap)
+      return noSlot;
+    if(backgroundRunning.fetch_add(1, std::memory_order_acquire) < backgroundCap) {
+      ret = findJobIn(self, background);
+      if(ret != noSlot) return ret;//runJob releases the reservation
+    }
+    releaseBackground();
+    return noSlot;
+  };
+
+  //gives back a place under the background cap. A worker turned away by the cap might have parked since, and nothing else would wake it for the background work still queued, so wake one if there is more of it than workers running it.
+  void threadPool::releaseBackground() {
+    const uint32_t running = backgroundRunning.fetch_sub(1, std::memory_order_release) - 1;
+    if(pending[static_cast<size_t>(lane_e::eBackground)].load(std::memory_order_relaxed) > running) [[unlikely]]
+      wake();
+  };
+
+  //registers as a sleeper, has one last look for work, and if there is none (and waitingOn isn't done) sleeps until the next submit or counter finishing. Returns a job if one was found.
+  uint32_t threadPool::park(threadData_t* self, counter_t* waitingOn) {
+    sleepers.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);//pairs with the fence in wake: either we see the job or the submitter sees us
+    const uint32_t epoch = wakeEpoch.load(std::memory_order_acquire);
+    const uint32_t ret = findJob(self);
+    if(ret == noSlot && !exit.load(std::memory_order_acquire) && !(waitingOn && waitingOn->done()))
+      wakeEpoch.wait(epoch, std::memory_order_acquire);
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return ret;
+  };
+
+  //called after a job becomes findable
+  void threadPool::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleepers.load(std::memory_order_relaxed)) [[unlikely]] {
+      wakeEpoch.fetch_add(1, std::memory_order_release);
+      wakeEpoch.notify_one();
+    }
+  };
+
+  //member threads only. A background job must have been reserved a place under the cap, unless this worker is already inside one.
+  void threadPool::runJob(uint32_t slot) {
+    job_t& j = slots[slot].job;
+    counter_t* counter = slots[slot].counter;
+    const lane_e lane = j.lane, outerLane = currentWorker.lane;
+    const bool background = lane == lane_e::eBackground;
+    threadData_t* self = currentWorker.data;
+    currentWorker.lane = lane;
+    if(background)
+      self->backgroundDepth++;
+    j.entry(j.data);
+    j.entry = jobEntry_t();//so the slot doesn't keep the callback (and whatever it captured) alive until it is reused
+    const bool releaseCap = background && --self->backgroundDepth == 0;
+    currentWorker.lane = outerLane;
+    freeSlot(slot);
+    if(counter)
+      finish(counter);//before pending drops, so continuations are pending before this is not
+    std::atomic_uint64_t& p = pending[static_cast<size_t>(lane)];
+    if(p.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      p.notify_all();//for waitForAll and waitForLane
+    if(releaseCap)
+      releaseBackground();//after pending drops, so only other jobs count as queued
+  };
+
+  //the decrement that reaches zero is the last touch of c, because a waiter may let go of c as soon as it sees zero
+  void threadPool::finish(counter_t* c) {
+    uint64_t r = c->remaining.load(std::memory_order_relaxed);
+    std::vector<std::pair<job_t, counter_t*>> ready;
+    while(true) {
+      while(r > 1)//not the last, so there's nothing to start
+	if(c->remaining.compare_exchange_weak(r, r - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) [[likely]]
+	  return;
+      //probably the last. Mark it finishing and take the continuations together, so then() either sees finishing or leaves its job for us.
+      scopeLock l(&c->continuationsMutex);
+      if(c->remaining.compare_exchange_strong(r, counter_t::finishing | 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+	ready.swap(c->continuations);
+	break;
+      }
+    }
+    c->remaining.fetch_sub(counter_t::finishing | 1, std::memory_order_acq_rel);//after letting go of the lock
+    for(auto& [j, next] : ready)
+      enqueue(&j, next);//next was counted by then()
+    //waiters off the pool wait on finishedEpoch instead of c, since c might be gone by now
+    finishedEpoch.fetch_add(1, std::memory_order_release);
+    finishedEpoch.notify_all();
+    //members waiting on c park like idle workers
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(sleepers.load(std::memory_order_relaxed)) [[unlikely]] {
+      wakeEpoch.fetch_add(1, std::memory_order_release);
+      wakeEpoch.notify_all();
+    }
+  };
+
+  //runs jobs until until is done, or if it's null, until the pool shuts down
+  void threadPool::work(threadData_t* self, counter_t* until) {
+    uint32_t idle = 0;
+    const uint32_t spins = thread::spinBudget.load(std::memory_order_relaxed), idleBudget = spins + thread::yieldBudget.load(std::memory_order_relaxed);
+    while(until ? !until->done() : !exit.load(std::memory_order_consume)) {
+      uint32_t slot = findJob(self);
+      if(slot == noSlot) [[unlikely]] {
+	if(idle < idleBudget) {
+	  if(idle >= spins)
+	    thread::sleepShort();
+	  idle++;
+	  continue;
+	}
+	slot = park(self, until);
+	idle = 0;//woken because something was submitted, so look hard again
+	if(slot == noSlot)
+	  continue;
+      }
+      idle = 0;
+      runJob(slot);
+    }
+  };
+
+  void threadPool::workerEntry(threadPool::threadData_t* threadData) {
+    threadData->thread = thread::current();
+    if(threadData->cpus.size() && !thread::setAffinity(threadData->cpus)) [[unlikely]]
+      WARN("could not pin pool worker ", threadData->idx);
+    currentWorker = { this, threadData, lane_e::eNormal };
+    work(threadData, NULL);
+    currentWorker = { NULL, NULL, lane_e::eNormal };
   };
 
   threadPool::threadPool() : threadPool(configuration::getOption("threadsperpool", max(1, thread::guessCpuCount()-2))) {};
 
-  threadPool::threadPool(uint64_t threadCount) : threadCount(threadCount) {
+  threadPool::threadPool(uint64_t threadCount) :
+    threadCount(threadCount),
+    backgroundCap(max(1u, static_cast<uint32_t>(threadCount * configuration::getOption("backgroundshare", 0.25f) + 0.5f))),
+    freeSlots(noSlot)
+  {
     thread::init();//repeated calling not a problem
     threads = std::make_unique<threadData_t[]>(threadCount);
+    const char* affinity = configuration::getOption("threadaffinity");
+    const bool pinCores = affinity && strcmp(affinity, "cores") == 0, pinNodes = affinity && strcmp(affinity, "nodes") == 0;
+    if(affinity && !pinCores && !pinNodes && strcmp(affinity, "none") != 0) [[unlikely]]
+      WARN("unknown threadaffinity: ", affinity, ", expected none, cores or nodes");
+    const auto& topology = thread::numaNodes();
+    nodeCount = pinCores || pinNodes ? static_cast<uint32_t>(topology.size()) : 1;
+    nodes = std::make_unique<node_t[]>(nodeCount);
+    for(size_t i = 0;i < threadCount;i++) {
+      threadData_t& td = threads[i];
+      td.idx = static_cast<uint32_t>(i);
+      //spread workers across nodes in turn, and across each node's cpus in turn
+      td.node = static_cast<uint32_t>(i % nodeCount);
+      nodes[td.node].workers.push_back(td.idx);
+      if(pinNodes) {
+	td.cpus = topology[td.node];
+      } else if(pinCores) {
+	const auto& cpus = topology[td.node];
+	td.cpus = { cpus[(i / nodeCount) % cpus.size()] };
+      }
+    }
+    if(nodeCount > 1)
+      for(uint32_t n = 0;n < nodeCount;n++)
+	for(uint32_t cpu : topology[n]) {//below thread::maxCpus, see parseCpuList
+	  if(cpuNode.size() <= cpu)
+	    cpuNode.resize(cpu + 1, 0);
+	  cpuNode[cpu] = n;
+	}
     for(size_t i = 0;i < threadCount;i++) {
       thread::spawnThread(thread::threadEntry_t_F::make<threadPool, threadData_t*>(this, &threads[i], &threadPool::workerEntry));
     }
@@ -47,49 +292,97 @@ namespace WITE {
 
   threadPool::~threadPool() {
     exit = true;
+    wakeEpoch.fetch_add(1, std::memory_order_release);
+    wakeEpoch.notify_all();
     for(size_t i = 0;i < threadCount;i++)
       threads[i].thread->join();
   };
 
-  void threadPool::submitJob(const job_t* j) {
-    scopeLock submitLock(&submitMutex);
+  void threadPool::submitJob(const job_t* j, counter_t* counter) {
+    if(counter)
+      counter->remaining.fetch_add(1, std::memory_order_relaxed);
+    enqueue(j, counter);
+  };
+
+  void threadPool::then(counter_t& after, const job_t* j, counter_t* counter) {
+    if(counter)
+      counter->remaining.fetch_add(1, std::memory_order_relaxed);
+    {
+      scopeLock l(&after.continuationsMutex);
+      const uint64_t r = after.remaining.load(std::memory_order_acquire);
+      if(r && !(r & counter_t::finishing)) {
+	after.continuations.emplace_back(*j, counter);
+	return;
+      }
+    }
+    enqueue(j, counter);
+  };
+
+  void threadPool::enqueue(const job_t* j, counter_t* counter) {
+    const size_t lane = static_cast<size_t>(j->lane);
+    pending[lane].fetch_add(1, std::memory_order_relaxed);//before it can be found, so waitForAll can't miss it
+    const uint32_t slot = allocateSlot();
+    slots[slot].job = *j;
+    slots[slot].counter = counter;
+    const bool member = currentWorker.pool == this;
+    if(member && currentWorker.data->jobs[lane].push(slot)) [[likely]] {
+      wake();//so a parked worker can steal it
+      return;
+    }
+    uint32_t node = 0;
+    if(member) {
+      node = currentWorker.data->node;
+    } else if(nodeCount > 1) {
+      uint32_t& home = submitterNodes.get()->node;
+      if(home == ~uint32_t(0)) [[unlikely]] {
+	const uint32_t cpu = thread::currentCpu();
+	home = cpu < cpuNode.size() ? cpuNode[cpu] : 0;
+      }
+      node = home;
+    }
     uint32_t sleepCnt = 0;
-    while(true) {
-      for(uint32_t k = 0;k < threadCount;k++) {
-	uint32_t i = (k + nextWorker) % threadCount;//round robin distributor with sporadic skipping
-	threadData_t& td = threads[i];
-	auto writeTarget = td.nextWrite.load(std::memory_order_acquire);
-	if(((writeTarget + 1) & jobMask) != td.nextRead.load(std::memory_order_consume)) [[unlikely]] {
-	  //there was room, there will continue to be room since we hold submitLock.
-	  td.jobs[writeTarget] = *j;
-	  td.nextWrite.store((writeTarget + 1) & jobMask, std::memory_order_release);
-	  nextWorker = (k + 1) % threadCount;
-	  return;
-	}
+    while(!nodes[node].injection[lane].push(slot)) [[unlikely]] {
+      if(member) {//our own deque is full too, and waiting on ourselves would never end
+	if(j->lane == lane_e::eBackground && !currentWorker.data->backgroundDepth)
+	  backgroundRunning.fetch_add(1, std::memory_order_acquire);//over the cap, briefly
+	runJob(slot);
+	return;
       }
       thread::sleepShort(sleepCnt);
     }
+    wake();
+  };
+
+  void threadPool::wait(counter_t& c) {
+    if(currentWorker.pool == this)
+      work(currentWorker.data, &c);
+    else
+      thread::waitFor(finishedEpoch, [&c]() { return c.done(); });
   };
 
   void threadPool::waitForAll() {
-    uint32_t sleepCnt = 0;
     ASSERT_TRAP(!onMemberThread(), "cannot wait a thread pool from one of its members.");
-    for(size_t i = 0;i < threadCount;i++) {
-      threadData_t& td = threads[i];
-      while(td.nextWrite.load(std::memory_order_consume) !=
-	    td.nextRead.load(std::memory_order_consume))//not empty
-	thread::sleepShort(sleepCnt);
-    }
+    //a job in one lane can submit to another, so only stop once a pass finds them all empty
+    bool busy;
+    do {
+      busy = false;
+      for(std::atomic_uint64_t& p : pending) {
+	if(p.load(std::memory_order_acquire)) {
+	  busy = true;
+	  thread::waitFor(p, [&p]() { return p.load(std::memory_order_acquire) == 0; });
+	}
+      }
+    } while(busy);
+  };
+
+  void threadPool::waitForLane(lane_e lane) {
+    ASSERT_TRAP(!onMemberThread(), "cannot wait a thread pool from one of its members.");
+    std::atomic_uint64_t& p = pending[static_cast<size_t>(lane)];
+    thread::waitFor(p, [&p]() { return p.load(std::memory_order_acquire) == 0; });
   };
 
   bool threadPool::onMemberThread() {
-    auto current = thread::current();
-    for(size_t i = 0;i < threadCount;i++) {
-      threadData_t& td = threads[i];
-      if(current == td.thread)
-	return true;
-    }
-    return false;
+    return currentWorker.pool == this;
   };
 
 }
@@ -14,43 +14,161 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 
 #pragma once
 
+#include <vector>
+
 #include "thread.hpp"
 #include "syncLock.hpp"
+#include "stableVector.hpp"
+#include "boundedQueue.hpp"
 
 namespace WITE {
 
+  //work-stealing pool. Each worker owns a deque (Chase-Lev): jobs submitted from inside a job go to the submitting worker's deque, which it pops newest first while idle workers steal oldest first.
+  //jobs submitted from other threads go through a shared injection queue, in order. Nothing takes a lock except growing the job storage.
+  //jobs can be grouped under a counter_t, to be waited on (from anywhere, including from inside a job) or continued with then().
+  //every job is in a lane. Workers take the highest lane with work before each job, so background work gives way to frame work as soon as its current job ends.
+  //placement (option threadaffinity): none (default) leaves workers to the os. cores pins each worker to one cpu, nodes pins each to the cpus of one NUMA node (see thread::numaNodes).
+  //when pinned, workers are grouped by node: each node has its own shared queues, and workers look on their own node before stealing from another.
   class threadPool {
   public:
     typedef uint64_t jobData_t[4];
     typedefCB(jobEntry_t, void, jobData_t&);
+    enum class lane_e : uint8_t {
+      eFrameCritical,//work the current frame is waiting on
+      eNormal,
+      eBackground//at most backgroundshare (option, default 1/4) of the workers run these at once, at least one
+    };
+    static constexpr size_t laneCount = 3;
     struct job_t {
       jobEntry_t entry;
       jobData_t data;//because creating a new callback for every job would waste time (malloc)
+      lane_e lane = lane_e::eNormal;
+    };
+
+    //handle on a group of jobs: counts the jobs submitted with it (and continuations registered to it) that have not finished yet. Reusable once done.
+    //must outlive its jobs. wait() on it before letting it go out of scope.
+    class counter_t {
+    public:
+      counter_t() = default;
+      counter_t(const counter_t&) = delete;
+      inline bool done() { return remaining.load(std::memory_order_acquire) == 0; };
+    private:
+      friend class threadPool;
+      static constexpr uint64_t finishing = uint64_t(1) << 63;//set in remaining while the last job takes the continuations, which then() treats as done
+      std::atomic_uint64_t remaining = 0;
+      syncLock continuationsMutex;
+      std::vector<std::pair<job_t, counter_t*>> continuations;//submitted when remaining next reaches 0, each counted by its own counter (if any)
     };
 
   private:
-    static constexpr size_t jobQueueSize = 1 << 6, jobMask = jobQueueSize-1;
+    static constexpr uint32_t noSlot = ~uint32_t(0);
+
+    //jobs are copied into pooled slots, and the queues pass slot indices around, so that no queue ever copies a job_t (which holds a shared_ptr) while another thread might be reading it
+    struct slot_t {
+      job_t job;
+      counter_t* counter;
+      std::atomic_uint32_t nextFree;
+    };
+
+    //Chase-Lev deque of slot indices with a fixed capacity. push and pop by the owning worker only, steal by anyone.
+    struct deque_t {
+      static constexpr int64_t capacity = 1 << 12, mask = capacity - 1;
+      alignas(64) std::atomic_int64_t top = 0;
+      alignas(64) std::atomic_int64_t bottom = 0;
+      std::atomic_uint32_t items[capacity];
+      bool push(uint32_t slot);//false if full
+      uint32_t pop();
+      uint32_t steal();//noSlot if empty or if another thread won the race for the last job
+    };
 
-    struct threadData_t {
-      job_t jobs[jobQueueSize];
-      std::atomic_uint64_t nextRead = 0, nextWrite = 0;//equal means empty
+    struct alignas(64) threadData_t {
+      deque_t jobs[laneCount];
       thread* thread;
+      uint32_t idx, node;
+      uint32_t backgroundDepth = 0;//background jobs this worker is inside of. Nested ones don't count against the cap, so they can always finish.
+      std::vector<uint32_t> cpus;//pinned to these, all if empty
     };
 
-    syncLock submitMutex;//lock only required for submit, read cannot overflow and sporadic underflow is harmless
+    struct node_t {
+      mpmcQueue<uint32_t, 1 << 14> injection[laneCount];//slot indices
+      std::vector<uint32_t> workers;//indices into threads
+    };
+
+    //which pool and worker this thread belongs to, if any, and the lane of the job it is running
+    struct worker_t {
+      threadPool* pool;
+      threadData_t* data;
+      lane_e lane;
+    };
+    static thread_local worker_t currentWorker;
+
     std::unique_ptr<threadData_t[]> threads;
-    uint32_t threadCount, nextWorker;
+    uint32_t threadCount, backgroundCap, nodeCount;
+    std::unique_ptr<node_t[]> nodes;
+    std::vector<uint32_t> cpuNode;//node of each cpu, so submissions from outside the pool go to the submitter's node
+    struct submitterNode_t { uint32_t node = ~uint32_t(0); };
+    threadResource<submitterNode_t> submitterNodes;//node each thread outside the pool submits to, picked by the cpu of its first submission and kept, so a thread that migrates still keeps its submissions to a lane in one queue, in order
+    stableVector<slot_t> slots;
+    syncLock slotsGrowMutex { "threadPool::slotsGrowMutex" };
+    alignas(64) std::atomic_uint64_t freeSlots;//tagged head of the free slot stack: high 32 bits are an ABA counter, low 32 are the slot index or noSlot
+    alignas(64) std::atomic_uint64_t pending[laneCount] = {};//submitted and not yet finished, per lane. waitForAll and waitForLane park on these
+    alignas(64) std::atomic_uint32_t backgroundRunning = 0;//workers inside a background job, or about to be
+    //idle workers park on wakeEpoch once they've spun through their budget. Submitting only bumps it (and makes a syscall) when someone is parked.
+    alignas(64) std::atomic_uint32_t wakeEpoch = 0, sleepers = 0;
+    alignas(64) std::atomic_uint32_t finishedEpoch = 0;//bumped whenever a counter reaches zero, for waiters off the pool
     std::atomic_bool exit = false;
 
+    uint32_t allocateSlot();
+    void freeSlot(uint32_t);
+    uint32_t findJobIn(threadData_t*, size_t lane);
+    uint32_t findJob(threadData_t*);
+    void releaseBackground();
+    uint32_t park(threadData_t*, counter_t* waitingOn);
+    void wake();
+    void runJob(uint32_t slot);
+    void finish(counter_t*);
+    void enqueue(const job_t*, counter_t*);
+    void work(threadData_t*, counter_t* until);
     void workerEntry(threadData_t*);
 
+    template<class F> struct rangeJob_t {
+      static void cb(jobData_t& jd) { (*reinterpret_cast<F*>(jd[2]))(jd[0], jd[1]); };
+      static constexpr jobEntry_t_F::StaticCallback<> cbt = &cb;
+      static constexpr jobEntry_t_ce cbce = &cbt;
+    };
+
   public:
     threadPool();
     threadPool(uint64_t threadCount);
     ~threadPool();
-    void submitJob(const job_t*);
+    void submitJob(const job_t*, counter_t* counter = NULL);
+    void then(counter_t& after, const job_t*, counter_t* counter = NULL);//submits the job once after is done, or now if it already is. counter counts it from now.
+    void wait(counter_t&);//on a member thread this runs other jobs while it waits, so fork/join from inside a job doesn't idle the worker
+    //count work on a counter that isn't a job (like a suspended task, see task.hpp): hold adds one, release takes it away again and starts continuations just as a job finishing would
+    inline void hold(counter_t& c) { c.remaining.fetch_add(1, std::memory_order_relaxed); };
+    inline void release(counter_t& c) { finish(&c); };
     void waitForAll();
+    void waitForLane(lane_e);//only the jobs in that lane, including any submitted while waiting
     bool onMemberThread();
+    inline uint32_t getThreadCount() { return threadCount; };
+    static inline lane_e currentLane() { return currentWorker.lane; };//of the job this thread is running, eNormal off the pool
+
+    //calls f(b, e) over [begin, end) in chunks of grain (0: a few per thread) and returns when all are done. The last chunk runs on the calling thread. Safe from member threads.
+    template<class F> void parallelFor(uint64_t begin, uint64_t end, F f, uint64_t grain = 0, lane_e lane = currentLane()) {
+      if(begin >= end) [[unlikely]] return;
+      if(!grain)
+	grain = (end - begin - 1) / (threadCount * 4) + 1;
+      counter_t counter;
+      job_t j { jobEntry_t(rangeJob_t<F>::cbce), { 0, 0, reinterpret_cast<uint64_t>(&f) }, lane };
+      uint64_t i = begin;
+      for(;end - i > grain;i += grain) {
+	j.data[0] = i;
+	j.data[1] = i + grain;
+	submitJob(&j, &counter);
+      }
+      f(i, end);
+      wait(counter);
+    };
 
   };
 
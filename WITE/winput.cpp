@@ -25,7 +25,7 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 namespace WITE::winput {
 
   std::map<inputIdentifier, compositeInputData> allInputData;
-  concurrentReadSyncLock allInputData_mutex;
+  concurrentReadSyncLock allInputData_mutex { "winput::allInputData_mutex" };
   uint32_t frameStart = 0, lastFrameStart = 0;
   uint32_t frameKeyboardBuffer[maxFrameKeyboardBuffer];
   size_t frameKeyboardInsertPnt = 0;
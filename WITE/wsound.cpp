@@ -18,6 +18,8 @@ Stable and intermediate releases may be made continually. For this reason, a yea
 #include "wsound.hpp"
 #include "DEBUG.hpp"
 #include "configuration.hpp"
+#include "boundedQueue.hpp"
+#include "thread.hpp"
 
 namespace WITE::wsound {
 
@@ -27,8 +29,15 @@ namespace WITE::wsound {
   std::atomic<float>* combinedSounds;//note: two channel, alternating left and right speaker.
   size_t combinedSoundsSamples;
   constexpr size_t maxContinuousSounds = 10;
-  soundCB continuousSounds[maxContinuousSounds];
-  std::atomic_size_t continuousSoundCount;
+  //the list of continuous sounds belongs to the audio thread. Other threads send it changes through a queue, which the audio callback applies before it plays them.
+  struct continuousSoundChange {
+    soundCB add;
+    bool clear;
+  };
+  mpscQueue<continuousSoundChange, 64> continuousSoundChanges;
+  soundCB continuousSounds[maxContinuousSounds];//audio thread only
+  size_t continuousSoundCount;//audio thread only
+  std::atomic_size_t continuousSoundsRequested;//what the count will be once the queue is applied, so add can refuse past the limit
   uint64_t initTime;
 
   void SDLCALL sdlCallback(void*, Uint8* outRaw, int outBytes) {
@@ -42,9 +51,18 @@ namespace WITE::wsound {
 	c -= combinedSoundsSamples;
     }
     struct outputDescriptor od { framesPlayedPreviously, initTime + framesPlayedPreviously * 1000000000 / audioFormat.freq, audioFormat.freq, reinterpret_cast<sample*>(out), outSamples/2 };
+    continuousSoundChange change;
+    while(continuousSoundChanges.pop(change)) {
+      if(change.clear) {
+	for(size_t i = 0;i < continuousSoundCount;i++)
+	  continuousSounds[i] = soundCB();
+	continuousSoundCount = 0;
+      } else if(continuousSoundCount < maxContinuousSounds) [[likely]] {//only not if an add raced a clear
+	continuousSounds[continuousSoundCount++] = change.add;
+      }
+    }
     for(size_t i = 0;i < continuousSoundCount;i++)
-      if(continuousSounds[i])
-	continuousSounds[i](od);
+      continuousSounds[i](od);
   };
 
   constexpr SDL_AudioSpec idealAudioFormat {
@@ -66,6 +84,7 @@ namespace WITE::wsound {
   void initSound() {
     framesPlayed = 0;
     continuousSoundCount = 0;
+    continuousSoundsRequested = 0;
     SDL_InitSubSystem(SDL_INIT_AUDIO);
     adev = SDL_OpenAudioDevice(NULL, 0, &idealAudioFormat, &audioFormat, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
     ASSERT_TRAP(adev > 0, "failed to create audio device, with error: ", SDL_GetError());
@@ -87,21 +106,21 @@ namespace WITE::wsound {
   };
 
   void addContinuousSound(soundCB scb) {
-    size_t idx = continuousSoundCount.fetch_add(1, std::memory_order_relaxed);
-    //possible race condition here if co-executed with the audio callback, solved by null check therein
-    if(idx >= maxContinuousSounds) [[unlikely]] {
+    if(continuousSoundsRequested.fetch_add(1, std::memory_order_relaxed) >= maxContinuousSounds) [[unlikely]] {
       WARN("skipping continuous sound because the limit of ", maxContinuousSounds, " has been reached");
-      continuousSoundCount.fetch_add(-1, std::memory_order_relaxed);
+      continuousSoundsRequested.fetch_sub(1, std::memory_order_relaxed);
       return;
     }
-    continuousSounds[idx] = scb;
+    uint32_t sleepCnt = 0;
+    while(!continuousSoundChanges.push(continuousSoundChange { scb, false })) [[unlikely]]
+      thread::sleepShort(sleepCnt);//the audio thread is behind on a burst of changes
   };
 
   void clearContinuousSounds() {
-    //technically this could race, but we don't expect to be calling this and add at the same time, ever
-    auto end = continuousSoundCount.exchange(0, std::memory_order_relaxed);
-    for(size_t i = 0;i < end;i++)
-      continuousSounds[i] = NULL;
+    continuousSoundsRequested.store(0, std::memory_order_relaxed);
+    uint32_t sleepCnt = 0;
+    while(!continuousSoundChanges.push(continuousSoundChange { soundCB(), true })) [[unlikely]]
+      thread::sleepShort(sleepCnt);
   };
 
 }
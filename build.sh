@@ -26,6 +26,7 @@ BOTHOPTS="-DVK_NO_PROTOTYPES -DVULKAN_HPP_NO_EXCEPTIONS"
 # -DWITE_DEBUG_IMAGE_BARRIERS
 # -DWITE_DEBUG_FENCES
 # -DWITE_DEBUG_DB
+# -DWITE_LOCK_PROFILE
 BASEDIR="$(cd "$(dirname "$0")"; pwd -L)"
 OUTDIR="${BASEDIR}/build"
 LOGFILE="${OUTDIR}/buildlog.txt"